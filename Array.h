@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "get_index_label.h"
 #include "IndexedContainerMemoryRegionOwner.h"
 #include "utils/Array.h"
@@ -16,34 +20,38 @@ class Array : public IndexedContainerMemoryRegionOwner, public utils::Array<T, N
   constexpr Array(std::weak_ptr<GraphTracker> const& root_graph, std::initializer_list<T> ilist, std::string_view what) :
     IndexedContainerMemoryRegionOwner(root_graph,
         reinterpret_cast<char*>(static_cast<std::array<T, N>*>(this)),
-        sizeof(T), N, typeid(_Index), get_index_label<_Index>(), what),
+        sizeof(T), N, index_type_label<_Index>(), what),
     utils::Array<T, N, _Index>(ilist)
   {
+    end_bulk_construction();
   }
 
   Array(std::weak_ptr<GraphTracker> const& root_graph, std::string_view what) :
     IndexedContainerMemoryRegionOwner(root_graph,
         reinterpret_cast<char*>(static_cast<std::array<T, N>*>(this)),
-        sizeof(T), N, typeid(_Index), get_index_label<_Index>(), what),
+        sizeof(T), N, index_type_label<_Index>(), what),
     utils::Array<T, N, _Index>()
   {
+    end_bulk_construction();
   }
 
   Array(Array const& other, std::string_view what) :
     IndexedContainerMemoryRegionOwner(other,
         reinterpret_cast<char*>(static_cast<std::array<T, N>*>(this)),
-        typeid(_Index), what),
+        index_type_label<_Index>(), what),
     utils::Array<T, N, _Index>(other)
   {
+    end_bulk_construction();
   }
 
 #ifdef CPPGRAPHVIZ_USE_WHAT
   Array(Array const& other) :
     IndexedContainerMemoryRegionOwner(other,
         reinterpret_cast<char*>(static_cast<std::array<T, N>*>(this)),
-        typeid(_Index), "Array(Array const&) of " + other.get_what()),
+        index_type_label<_Index>(), "Array(Array const&) of " + other.get_what()),
     utils::Array<T, N, _Index>(other)
   {
+    end_bulk_construction();
   }
 #endif
 
@@ -53,6 +61,7 @@ class Array : public IndexedContainerMemoryRegionOwner, public utils::Array<T, N
         what),
     utils::Array<T, N, _Index>(std::move(other))
   {
+    end_bulk_construction();
   }
 
 #ifdef CPPGRAPHVIZ_USE_WHAT
@@ -62,6 +71,7 @@ class Array : public IndexedContainerMemoryRegionOwner, public utils::Array<T, N
         "Array(Array&&) of " + other.get_what()),
     utils::Array<T, N, _Index>(std::move(other))
   {
+    end_bulk_construction();
   }
 #endif
 
@@ -75,3 +85,5 @@ class Array : public IndexedContainerMemoryRegionOwner, public utils::Array<T, N
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "debug.h"
+
+namespace cppgraphviz {
+
+// A list of weak pointers to the trackers of the children of a graph.
+//
+// Every child gets a slot when it is added, which it keeps until it is erased. Passing
+// that slot to erase makes removing a child a constant time operation. Erased slots are
+// reused by add, as are the slots of children whose tracker expired without being erased:
+// each call to add checks a few slots for that, so that expired slots are reclaimed without
+// ever scanning the whole list at once.
+//
+// Iterating over a ChildSlots visits every slot, including the empty ones, which contain
+// an empty weak pointer that fails to lock.
+template<typename Tracker>
+class ChildSlots
+{
+ public:
+  static constexpr size_t no_slot = std::numeric_limits<size_t>::max();
+
+ private:
+  static constexpr int slots_checked_per_add = 2;
+
+  std::vector<std::weak_ptr<Tracker>> slots_;
+  std::vector<size_t> free_slots_;      // The slots that can be reused.
+  size_t sweep_position_ = 0;           // The next slot that is checked for an expired tracker.
+
+  static bool same_tracker(std::weak_ptr<Tracker> const& wp1, std::weak_ptr<Tracker> const& wp2)
+  {
+    // Compare the control blocks; this works for expired trackers too and does not lock anything.
+    return !wp1.owner_before(wp2) && !wp2.owner_before(wp1);
+  }
+
+  // Check up to slots_checked_per_add slots for trackers that expired without being erased.
+  void reclaim_expired()
+  {
+    for (int i = 0; i < slots_checked_per_add && !slots_.empty(); ++i)
+    {
+      if (sweep_position_ >= slots_.size())
+        sweep_position_ = 0;
+      std::weak_ptr<Tracker>& wp = slots_[sweep_position_];
+      // An empty weak_ptr is either expired or already in free_slots_; only the former has an owner.
+      if (wp.expired() && !same_tracker(wp, {}))
+      {
+        wp.reset();
+        free_slots_.push_back(sweep_position_);
+      }
+      ++sweep_position_;
+    }
+  }
+
+ public:
+  // Add tracker and return its slot.
+  size_t add(std::weak_ptr<Tracker> tracker)
+  {
+    reclaim_expired();
+    size_t slot;
+    if (!free_slots_.empty())
+    {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+      slots_[slot] = std::move(tracker);
+    }
+    else
+    {
+      slot = slots_.size();
+      slots_.push_back(std::move(tracker));
+    }
+    return slot;
+  }
+
+  // Erase tracker, which was added with slot (as returned by add).
+  // If slot is no_slot, or doesn't contain tracker, then the slot of tracker is searched for.
+  void erase(std::weak_ptr<Tracker> const& tracker, size_t slot = no_slot)
+  {
+    if (slot >= slots_.size() || !same_tracker(slots_[slot], tracker))
+    {
+      slot = 0;
+      while (slot < slots_.size() && !same_tracker(slots_[slot], tracker))
+        ++slot;
+      // Erasing a tracker that was never added?
+      ASSERT(slot < slots_.size());
+      if (slot == slots_.size())
+        return;
+    }
+    slots_[slot].reset();
+    free_slots_.push_back(slot);
+  }
+
+  // Remove all slots and return them.
+  std::vector<std::weak_ptr<Tracker>> release()
+  {
+    std::vector<std::weak_ptr<Tracker>> slots;
+    slots.swap(slots_);
+    free_slots_.clear();
+    sweep_position_ = 0;
+    return slots;
+  }
+
+  auto begin() const { return slots_.begin(); }
+  auto end() const { return slots_.end(); }
+};
+
+} // namespace cppgraphviz
@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "Node.h"
 
 namespace cppgraphviz {
@@ -45,6 +49,7 @@ class Class : public Graph
   void set_label(std::string const& label)
   {
     label_ = label;
+    this->mark_attributes_dirty();
   }
 
  private:
@@ -60,15 +65,19 @@ class Class : public Graph
  protected:
   void item_attributes(dot::AttributeList& list) override
   {
-    std::string prev_style;
+    // Add "rounded" to the style, unless it is already there (this is called again after every set_label).
+    std::string style;
     if (list.has_key("style"))
     {
-      prev_style = std::string{list.get_value("style")} + ",";
+      style = list.get_value("style");
       list.remove("style");
     }
-    list += {{"cluster", "true"}, {"style", prev_style + "rounded"}};
+    if (("," + style + ",").find(",rounded,") == std::string::npos)
+      style += style.empty() ? "rounded" : ",rounded";
+    list += {{"cluster", "true"}, {"style", style}};
     // Derive from Class and override item_attributes to add a shape, color etc.
     // Call set_label to set the label, or derive from Class and override item_attributes to add a label.
+    list.remove("label");
     if (label_.empty())
       list.add({"label", "<unknown Class>"});
     else
@@ -77,3 +86,5 @@ class Class : public Graph
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
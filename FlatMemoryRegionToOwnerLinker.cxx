@@ -0,0 +1,169 @@
+#include "sys.h"
+#include "FlatMemoryRegionToOwnerLinker.h"
+#include "Item.h"
+#include <algorithm>
+#ifdef CWDEBUG
+#include "debug_ostream_operators.h"
+#endif
+
+namespace cppgraphviz {
+
+namespace {
+
+// The order of the elements of FlatMemoryRegionToOwnerLinker::memory_region_to_owner_vector_:
+// sorted by begin and then by end in reverse, so that a region comes after all regions that contain it.
+bool comes_before(MemoryRegion const& lhs, MemoryRegion const& rhs)
+{
+  return lhs.begin() < rhs.begin() || (lhs.begin() == rhs.begin() && lhs.end() > rhs.end());
+}
+
+} // namespace
+
+size_t FlatMemoryRegionToOwnerLinker::last_element_beginning_at_or_before(char const* ptr) const
+{
+  auto iter = std::upper_bound(memory_region_to_owner_vector_.begin(), memory_region_to_owner_vector_.end(), ptr,
+      [](char const* key, Element const& element){ return key < element.memory_region().begin(); });
+  if (iter == memory_region_to_owner_vector_.begin())
+    return npos;
+  return iter - memory_region_to_owner_vector_.begin() - 1;
+}
+
+MemoryRegionToOwner const* FlatMemoryRegionToOwnerLinker::inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr,
+    MemoryRegion* cacheable_region, int* depth) const
+{
+  DoutEntering(dc::notice, "FlatMemoryRegionToOwnerLinker::inform_owner_of(" << item << ", " << node_ptr_ptr << ")");
+
+  MemoryRegion item_memory_region(reinterpret_cast<char*>(item), sizeof(Item));
+  size_t const last = last_element_beginning_at_or_before(item_memory_region.begin());
+
+  // If the region found ends before item, then the innermost region that contains item (if any) must be one of its parents.
+  size_t index = last;
+  while (index != npos && !memory_region_to_owner_vector_[index].memory_region().overlaps_with(item_memory_region))
+  {
+    if (depth)
+      ++*depth;
+    index = memory_region_to_owner_vector_[index].parent_;
+  }
+
+  // Inform the owner of the innermost region, falling back to the owners of the regions that
+  // contain it in case it was already destructed (see MemoryRegionToOwnerLinker::inform_owner_of).
+  for (size_t innermost = index; index != npos; index = memory_region_to_owner_vector_[index].parent_)
+  {
+    if (depth)
+      ++*depth;
+    MemoryRegionToOwner const& memory_region_to_owner = memory_region_to_owner_vector_[index].memory_region_to_owner_;
+    if (memory_region_to_owner.inform_owner(item_memory_region, node_ptr_ptr))
+    {
+      if (cacheable_region && index == innermost)
+      {
+        // Every Item between the end of the last region that begins before item (unless that is the innermost region
+        // itself) and the begin of the next region (which, if it begins before its end, lays within the innermost region)
+        // has the same innermost region.
+        MemoryRegion const& owner_memory_region = memory_region_to_owner.memory_region();
+        char const* begin = last == index ? owner_memory_region.begin() : memory_region_to_owner_vector_[last].memory_region().end();
+        char const* end = owner_memory_region.end();
+        if (last + 1 < memory_region_to_owner_vector_.size() && memory_region_to_owner_vector_[last + 1].memory_region().begin() < end)
+          end = memory_region_to_owner_vector_[last + 1].memory_region().begin();
+        cacheable_region->critical_area_assign({const_cast<char*>(begin), static_cast<size_t>(end - begin)});
+      }
+      return &memory_region_to_owner;
+    }
+    Dout(dc::notice, "owner of " << memory_region_to_owner << " is gone; trying its parent.");
+  }
+
+  // This can also happen when creating a temporary in the constructor of a class;
+  // in that case we don't add item to any graph until they are moved (or copied) into
+  // a memory region that belongs to a managed Class or Array, later on.
+  return nullptr;
+}
+
+bool FlatMemoryRegionToOwnerLinker::register_new_memory_region_for(MemoryRegion memory_region,
+    MemoryRegionOwner::handle_type owner)
+{
+  DoutEntering(dc::notice, "FlatMemoryRegionToOwnerLinker::register_new_memory_region_for(" << memory_region << ", " << owner << ")");
+
+  // Insert the new region after any existing region with the same begin and end,
+  // so that registering the same region twice nests the second one inside the first.
+  auto iter = std::upper_bound(memory_region_to_owner_vector_.begin(), memory_region_to_owner_vector_.end(), memory_region,
+      [](MemoryRegion const& key, Element const& element){ return comes_before(key, element.memory_region()); });
+  size_t const pos = iter - memory_region_to_owner_vector_.begin();
+
+  // Find the innermost region that contains the new one.
+  size_t parent = pos == 0 ? npos : pos - 1;
+  while (parent != npos && !memory_region.lays_within(memory_region_to_owner_vector_[parent].memory_region()))
+  {
+    // Memory regions can be inside one another, but they can not partially overlap.
+    ASSERT(!memory_region.overlaps_with(memory_region_to_owner_vector_[parent].memory_region()));
+    parent = memory_region_to_owner_vector_[parent].parent_;
+  }
+  size_t const depth = parent == npos ? 0 : memory_region_to_owner_vector_[parent].depth_ + 1;
+
+  // Make room for the new element.
+  for (Element& element : memory_region_to_owner_vector_)
+    if (element.parent_ != npos && element.parent_ >= pos)
+      ++element.parent_;
+  memory_region_to_owner_vector_.emplace(iter, MemoryRegionToOwner{memory_region, owner}, parent, depth);
+
+  // Normally the outer region is registered first, but if the new region happens to contain
+  // regions that were registered before it, then those have to be moved one level deeper.
+  for (size_t index = pos + 1;
+      index < memory_region_to_owner_vector_.size() && memory_region_to_owner_vector_[index].memory_region().begin() < memory_region.end();
+      ++index)
+  {
+    Element& element = memory_region_to_owner_vector_[index];
+    ASSERT(element.memory_region().lays_within(memory_region));
+    if (element.parent_ == parent)
+      element.parent_ = pos;
+    ++element.depth_;
+  }
+
+  Dout(dc::notice, "after:\n" << *this);
+
+  return parent != npos;
+}
+
+void FlatMemoryRegionToOwnerLinker::unregister_memory_region(MemoryRegion memory_region)
+{
+  DoutEntering(dc::notice, "FlatMemoryRegionToOwnerLinker::unregister_memory_region(" << memory_region << ")");
+
+  // Find the outermost region that is equal to memory_region.
+  auto iter = std::lower_bound(memory_region_to_owner_vector_.begin(), memory_region_to_owner_vector_.end(), memory_region,
+      [](Element const& element, MemoryRegion const& key){ return comes_before(element.memory_region(), key); });
+
+  // Just like MemoryRegionToOwnerLinker, removing a region also removes all regions that
+  // were registered inside it. It is therefore possible that we fail to find a memory region
+  // because it fell inside another memory region that was already removed.
+  // See MemoryRegionToOwnerLinker::unregister_memory_region for how that can happen.
+  if (iter == memory_region_to_owner_vector_.end() || !(iter->memory_region() == memory_region))
+    return;
+
+  // Find the end of the range of descendants of the region being removed.
+  size_t const depth = iter->depth_;
+  auto last = std::find_if(iter + 1, memory_region_to_owner_vector_.end(),
+      [depth](Element const& element){ return element.depth_ <= depth; });
+  size_t const first_index = iter - memory_region_to_owner_vector_.begin();
+  size_t const last_index = last - memory_region_to_owner_vector_.begin();
+
+  memory_region_to_owner_vector_.erase(iter, last);
+
+  // Elements after the erased range can not have a parent inside that range.
+  size_t const count = last_index - first_index;
+  for (size_t index = first_index; index < memory_region_to_owner_vector_.size(); ++index)
+  {
+    Element& element = memory_region_to_owner_vector_[index];
+    if (element.parent_ != npos && element.parent_ >= last_index)
+      element.parent_ -= count;
+  }
+
+  Dout(dc::notice, "after:\n" << *this);
+}
+
+#ifdef CWDEBUG
+void FlatMemoryRegionToOwnerLinker::print_on(std::ostream& os) const
+{
+  for (Element const& element : memory_region_to_owner_vector_)
+    os << std::string(4 * element.depth_, ' ') << element.memory_region_to_owner_ << '\n';
+}
+#endif
+
+} // namespace cppgraphviz
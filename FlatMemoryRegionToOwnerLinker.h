@@ -0,0 +1,72 @@
+#pragma once
+
+#include "MemoryRegionToOwner.h"
+#include <vector>
+#ifdef CWDEBUG
+#include "utils/has_print_on.h"
+#endif
+
+namespace cppgraphviz {
+#ifdef CWDEBUG
+using utils::has_print_on::operator<<;
+#endif
+
+class Item;
+
+// An alternative for MemoryRegionToOwnerLinker that stores all memory regions,
+// regardless of their nesting depth, in a single sorted vector.
+//
+// Because memory regions can be inside one another but never partially overlap,
+// sorting them by begin (ascending) and then by end (descending) puts every region
+// after all regions that contain it. Each element also stores the index of its
+// parent (the innermost region that contains it) and its nesting depth, so that:
+//
+// * finding the innermost region that contains an Item is a single binary search,
+//   followed by walking up the (short) chain of parents when the region found ends
+//   before the Item;
+// * the descendants of a region are the elements directly following it that have
+//   a larger depth, so that removing a region together with everything that was
+//   registered inside it is a single erase of a contiguous range.
+//
+// The price is that registering and unregistering are O(number of regions) because
+// of the vector insert/erase and the fix up of the parent indices. This is a good
+// trade-off when there are many more lookups than (un)registrations.
+//
+class FlatMemoryRegionToOwnerLinker
+{
+ private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  struct Element
+  {
+    MemoryRegionToOwner memory_region_to_owner_;
+    size_t parent_;             // Index into memory_region_to_owner_vector_ of the innermost region that contains this one, or npos.
+    size_t depth_;              // The number of registered regions that contain this one.
+
+    Element(MemoryRegionToOwner&& memory_region_to_owner, size_t parent, size_t depth) :
+      memory_region_to_owner_(std::move(memory_region_to_owner)), parent_(parent), depth_(depth) { }
+
+    MemoryRegion const& memory_region() const { return memory_region_to_owner_.memory_region(); }
+  };
+
+  std::vector<Element> memory_region_to_owner_vector_;
+
+ private:
+  // Return the index of the last element whose region begins at or before ptr, or npos if there is no such element.
+  size_t last_element_beginning_at_or_before(char const* ptr) const;
+
+ public:
+  // See MemoryRegionToOwnerLinker.
+  MemoryRegionToOwner const* inform_owner_of(Item* item, dot::NodePtr* node_ptr = nullptr, MemoryRegion* cacheable_region = nullptr,
+      int* depth = nullptr) const;
+  bool register_new_memory_region_for(MemoryRegion memory_region, MemoryRegionOwner::handle_type owner);
+  void unregister_memory_region(MemoryRegion memory_region);
+
+  bool empty() const { return memory_region_to_owner_vector_.empty(); }
+
+#ifdef CWDEBUG
+  void print_on(std::ostream& os) const;
+#endif
+};
+
+} // namespace cppgraphviz
@@ -9,6 +9,26 @@ namespace cppgraphviz {
 GraphTracker::GraphTracker(utils::Badge<threadsafe::TrackedObject<Graph, GraphTracker>>, Graph& graph) :
   threadsafe::ObjectTracker<Graph, locked_Graph, dot::ItemLockingPolicy>(graph)
 {
+  // Everything that changes the output of this graph calls mark_subtree_dirty (see locked_Graph::mark_output_changed).
+  dot::GraphPtr::unlocked_type::wat{graph_ptr_.item()}->enable_subtree_cache();
+}
+
+bool GraphTracker::mark_dirty()
+{
+  // Use & instead of && so that both flags are set.
+  return !(subtree_dirty_.exchange(true) & output_dirty_.exchange(true));
+}
+
+void GraphTracker::mark_subtree_dirty()
+{
+  // A graph is only cleared (by locked_Graph::initialize_item, respectively locked_Graph::mark_output_changed)
+  // after the graph above it was cleared, so once a graph is found that is already marked, all graphs above
+  // it are marked too.
+  if (!mark_dirty())
+    return;
+  std::shared_ptr<GraphTracker> graph_tracker = parent_t::crat{parent_}->lock();
+  while (graph_tracker && graph_tracker->mark_dirty())
+    graph_tracker = parent_t::crat{graph_tracker->parent_}->lock();
 }
 
 // Create a new Graph/GraphTracker pair. This is a root graph.
@@ -29,7 +49,7 @@ locked_Graph::locked_Graph(std::weak_ptr<GraphTracker> const& root_graph, std::s
 
 // Create a new Graph/GraphTracker pair. This is a subgraph.
 locked_Graph::locked_Graph(MemoryRegion memory_region, std::weak_ptr<GraphTracker> const& root_graph, std::string_view what) :
-  ItemTemplate<Graph, GraphTracker>(root_graph, this), MemoryRegionOwner(memory_region)
+  ItemTemplate<Graph, GraphTracker>(root_graph, this), MemoryRegionOwner(memory_region, MemoryRegionSource::Class)
 {
   DoutEntering(dc::notice, "locked_Graph(" << memory_region << ", " << root_graph << ", \"" << what << "\") [" << this << "]");
   tracker_->set_what(what);
@@ -41,10 +61,12 @@ locked_Graph::locked_Graph(locked_Graph&& orig, std::string_view what) :
   ItemTemplate<Graph, GraphTracker>(std::move(orig)),
   node_trackers_(std::move(orig.node_trackers_)),
   graph_trackers_(std::move(orig.graph_trackers_)),
-  array_trackers_(std::move(orig.array_trackers_))
+  array_handles_(std::move(orig.array_handles_)),
+  free_array_slots_(std::move(orig.free_array_slots_)),
+  indexed_container_sets_(std::move(orig.indexed_container_sets_))
 {
   DoutEntering(dc::notice, "locked_Graph(locked_Graph&& " << &orig << ", \"" << what << "\") [" << this << "]");
-  tracker_->set_what(what);
+  change_what(what);
 }
 
 // Move a Graph, updating its GraphTracker.
@@ -53,18 +75,20 @@ locked_Graph::locked_Graph(locked_Graph&& orig, MemoryRegion const& memory_regio
   MemoryRegionOwner(std::move(orig), memory_region),
   node_trackers_(std::move(orig.node_trackers_)),
   graph_trackers_(std::move(orig.graph_trackers_)),
-  array_trackers_(std::move(orig.array_trackers_))
+  array_handles_(std::move(orig.array_handles_)),
+  free_array_slots_(std::move(orig.free_array_slots_)),
+  indexed_container_sets_(std::move(orig.indexed_container_sets_))
 {
   DoutEntering(dc::notice, "locked_Graph(locked_Graph&& " << &orig << ", " << memory_region << ", \"" << what << "\") [" << this << "]");
-  tracker_->set_what(what);
+  change_what(what);
 }
 
 locked_Graph::locked_Graph(MemoryRegion memory_region, locked_Graph const& other, std::string_view what) :
   ItemTemplate<Graph, GraphTracker>(other.root_graph_tracker(), this),
-  MemoryRegionOwner(memory_region),
+  MemoryRegionOwner(memory_region, MemoryRegionSource::Class),
   node_trackers_{},
   graph_trackers_{},
-  array_trackers_{}
+  array_handles_{}
 {
   DoutEntering(dc::notice, "locked_Graph(" << memory_region << ", locked_Graph const& " << &other << ", \"" << what << "\") [" << this << "]");
   tracker_->set_what(what);
@@ -79,16 +103,52 @@ locked_Graph::~locked_Graph()
   if (parent_graph_tracker)
     parent_graph_tracker->tracked_wat()->remove_graph(std::move(tracker_));
 
-  // Make a copy of the child items and then remove them from this graph for proper bookkeeping.
-  auto node_trackers = std::move(node_trackers_);
-  auto graph_trackers = std::move(graph_trackers_);
-  auto array_trackers = std::move(array_trackers_);
+  detach_all_children();
+}
+
+// Remove all children from this graph at once.
+//
+// Unlike calling remove_node and remove_graph for every child, this locks each child only
+// once (to clear its parent) and the dot::GraphItem only once (to remove all of them).
+void locked_Graph::detach_all_children()
+{
+  auto node_trackers = node_trackers_.release();
+  auto graph_trackers = graph_trackers_.release();
+  array_handles_.clear();
+  free_array_slots_.clear();
+
+  // Keep the children alive until they are removed from the dot::GraphItem.
+  std::vector<std::shared_ptr<NodeTracker>> children;
+  std::vector<std::shared_ptr<GraphTracker>> subgraphs;
+  children.reserve(node_trackers.size());
+  subgraphs.reserve(graph_trackers.size());
   for (auto& weak_node_tracker : node_trackers)
-    remove_node(weak_node_tracker.lock());
+    if (auto node_tracker = weak_node_tracker.lock())
+    {
+      node_tracker->tracked_wat()->set_parent_graph_tracker({});
+      children.push_back(std::move(node_tracker));
+    }
   for (auto& weak_graph_tracker : graph_trackers)
-    remove_graph(weak_graph_tracker.lock());
-  for (auto& weak_array_tracker : array_trackers)
-    remove_array(weak_array_tracker.lock());
+    if (auto graph_tracker = weak_graph_tracker.lock())
+    {
+      graph_tracker->set_parent({});
+      graph_tracker->tracked_wat()->set_parent_graph_tracker({});
+      subgraphs.push_back(std::move(graph_tracker));
+    }
+
+  // A graph that was moved has nothing left to remove (and no tracker_).
+  if (children.empty() && subgraphs.empty() && indexed_container_sets_.empty())
+    return;
+
+  dot::GraphPtr::unlocked_type::wat graph_ptr_w{tracker_->graph_ptr().item()};
+  for (auto const& node_tracker : children)
+    graph_ptr_w->remove(node_tracker->node_ptr());
+  for (auto const& graph_tracker : subgraphs)
+    graph_ptr_w->remove(graph_tracker->graph_ptr());
+  // Release the container sets of a root graph; a set that still contains containers is destroyed together with the last one.
+  for (auto& key_set_pair : indexed_container_sets_)
+    graph_ptr_w->erase(*key_set_pair.second);
+  indexed_container_sets_.clear();
 }
 
 void locked_Graph::add_node(std::weak_ptr<NodeTracker> weak_node_tracker)
@@ -97,21 +157,24 @@ void locked_Graph::add_node(std::weak_ptr<NodeTracker> weak_node_tracker)
   if (node_tracker)
   {
     dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->add(node_tracker->node_ptr());
-    node_trackers_.push_back(std::move(weak_node_tracker));
+    node_tracker->set_parent_slot(node_trackers_.add(std::move(weak_node_tracker)));
+    node_tracker->mark_attributes_dirty();
     node_tracker->tracked_wat()->set_parent_graph_tracker(tracker_);
+    tracker_->mark_subtree_dirty();
   }
 }
 
 void locked_Graph::remove_node(std::shared_ptr<NodeTracker>&& node_tracker)
 {
-  node_tracker->tracked_wat()->set_parent_graph_tracker({});
-  // Erase node_tracker and any expired elements from node_trackers_.
-  std::erase_if(node_trackers_,
-      [&node_tracker](std::weak_ptr<NodeTracker> const& wp){
-        auto sp = wp.lock();
-        return !sp || sp == node_tracker;
-      });
-  dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->remove(node_tracker->node_ptr());
+  node_trackers_.erase(node_tracker, node_tracker->parent_slot());
+  detach_node(*node_tracker);
+}
+
+void locked_Graph::detach_node(NodeTracker& node_tracker)
+{
+  node_tracker.tracked_wat()->set_parent_graph_tracker({});
+  dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->remove(node_tracker.node_ptr());
+  tracker_->mark_subtree_dirty();
 }
 
 void locked_Graph::add_graph(std::weak_ptr<GraphTracker> weak_graph_tracker)
@@ -120,46 +183,85 @@ void locked_Graph::add_graph(std::weak_ptr<GraphTracker> weak_graph_tracker)
   if (graph_tracker)
   {
     dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->add(graph_tracker->graph_ptr());
-    graph_trackers_.push_back(std::move(weak_graph_tracker));
+    graph_tracker->set_parent_slot(graph_trackers_.add(std::move(weak_graph_tracker)));
+    graph_tracker->set_parent(tracker_);
+    graph_tracker->mark_attributes_dirty();
     graph_tracker->tracked_wat()->set_parent_graph_tracker(tracker_);
+    // The new subgraph might already have been marked, in which case that stopped before reaching this graph.
+    tracker_->mark_subtree_dirty();
   }
 }
 
 void locked_Graph::remove_graph(std::shared_ptr<GraphTracker>&& graph_tracker)
 {
-  graph_tracker->tracked_wat()->set_parent_graph_tracker({});
-  // Erase graph_tracker and any expired elements from graph_trackers_.
-  std::erase_if(graph_trackers_,
-      [&graph_tracker](std::weak_ptr<GraphTracker> const& wp){
-        auto sp = wp.lock();
-        return !sp || sp == graph_tracker;
-      });
-  dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->remove(graph_tracker->graph_ptr());
+  graph_trackers_.erase(graph_tracker, graph_tracker->parent_slot());
+  detach_graph(*graph_tracker);
 }
 
-void locked_Graph::add_array(std::weak_ptr<MemoryRegionOwnerTracker> weak_array_tracker)
+void locked_Graph::detach_graph(GraphTracker& graph_tracker)
 {
-  std::shared_ptr<MemoryRegionOwnerTracker> array_tracker = weak_array_tracker.lock();
-  if (array_tracker)
+  graph_tracker.set_parent({});
+  graph_tracker.tracked_wat()->set_parent_graph_tracker({});
+  dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->remove(graph_tracker.graph_ptr());
+  tracker_->mark_subtree_dirty();
+}
+
+size_t locked_Graph::add_array(MemoryRegionOwner::handle_type array_handle)
+{
+  // The elements of the new array must be initialized.
+  tracker_->mark_elements_dirty();
+  size_t array_slot;
+  if (!free_array_slots_.empty())
+  {
+    array_slot = free_array_slots_.back();
+    free_array_slots_.pop_back();
+    array_handles_[array_slot] = array_handle;
+  }
+  else
   {
-    array_trackers_.push_back(std::move(weak_array_tracker));
+    array_slot = array_handles_.size();
+    array_handles_.push_back(array_handle);
   }
+  return array_slot;
 }
 
-void locked_Graph::remove_array(std::shared_ptr<MemoryRegionOwnerTracker>&& array_tracker)
+void locked_Graph::remove_array(MemoryRegionOwner::handle_type array_handle, size_t array_slot)
 {
-  // Erase array_tracker and any expired elements from array_trackers_.
-  std::erase_if(array_trackers_,
-      [&array_tracker](std::weak_ptr<MemoryRegionOwnerTracker> const& wp){
-        auto sp = wp.lock();
-        return !sp || sp == array_tracker;
-      });
+  // The slot is gone if this graph already dropped all its arrays (see detach_all_children).
+  if (array_slot >= array_handles_.size() || array_handles_[array_slot] != array_handle)
+    return;
+  array_handles_[array_slot] = {};
+  free_array_slots_.push_back(array_slot);
+}
+
+std::shared_ptr<IndexedContainerSet> locked_Graph::get_indexed_container_set(
+    IndexTypeLabel const* index_type_label, char const* label_prefix)
+{
+  auto ibp = indexed_container_sets_.try_emplace({ index_type_label, label_prefix });
+  if (ibp.second)
+  {
+    ibp.first->second = std::make_shared<IndexedContainerSet>(label_prefix + index_type_label->label_ + "]",
+        "locked_Graph::indexed_container_sets_");
+    dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->insert(*ibp.first->second);
+  }
+  return ibp.first->second;
 }
 
 void locked_Graph::initialize_item()
 {
-  // Add the attributes of this Node.
-  item_attributes(dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->attribute_list());
+  // Nothing in this graph has to be initialized if nothing in it changed.
+  if (!tracker_->subtree_dirty())
+    return;
+  // Clear the flag first, so that a concurrent change marks it dirty again.
+  tracker_->clear_subtree_dirty();
+  if (tracker_->attributes_dirty())
+  {
+    // Clear the flag first, so that a concurrent change marks it dirty again.
+    tracker_->clear_attributes_dirty();
+    // Add the attributes of this Graph.
+    item_attributes(dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->attribute_list());
+  }
+  // Initialize the items of this graph that changed.
   call_initialize_on_items();
 }
 
@@ -168,7 +270,8 @@ void locked_Graph::call_initialize_on_items() const
   for (std::weak_ptr<NodeTracker> const& weak_node_tracker : node_trackers_)
   {
     std::shared_ptr<NodeTracker> node_tracker = weak_node_tracker.lock();
-    if (node_tracker)
+    // Don't lock nodes whose attributes didn't change.
+    if (node_tracker && node_tracker->attributes_dirty())
     {
       auto item_w = node_tracker->tracked_wat();
       item_w->initialize_item();
@@ -177,27 +280,50 @@ void locked_Graph::call_initialize_on_items() const
   for (std::weak_ptr<GraphTracker> const& weak_graph_tracker : graph_trackers_)
   {
     std::shared_ptr<GraphTracker> graph_tracker = weak_graph_tracker.lock();
-    if (graph_tracker)
+    // Don't lock subgraphs that contain nothing that changed.
+    if (graph_tracker && graph_tracker->subtree_dirty())
     {
       auto item_w = graph_tracker->tracked_wat();
       item_w->initialize_item();
     }
   }
-  for (std::weak_ptr<MemoryRegionOwnerTracker> const& weak_array_tracker : array_trackers_)
+  // Only a root graph has arrays; don't visit their elements if none of them changed.
+  if (array_handles_.empty() || !tracker_->elements_dirty())
+    return;
+  tracker_->clear_elements_dirty();
+  for (MemoryRegionOwner::handle_type array_handle : array_handles_)
   {
-    std::shared_ptr<MemoryRegionOwnerTracker> array_tracker = weak_array_tracker.lock();
-    if (array_tracker)
+    MemoryRegionOwner* memory_region_owner = MemoryRegionOwner::handle_table().get(array_handle);
+    if (memory_region_owner)
     {
-      MemoryRegionOwner& memory_region_owner = array_tracker->tracked_object();
-      IndexedContainerMemoryRegionOwner& array_memory_region_owner = static_cast<IndexedContainerMemoryRegionOwner&>(memory_region_owner);
-      array_memory_region_owner.call_initialize_on_elements();
+      IndexedContainerMemoryRegionOwner* array_memory_region_owner = static_cast<IndexedContainerMemoryRegionOwner*>(memory_region_owner);
+      array_memory_region_owner->call_initialize_on_elements();
     }
   }
 }
 
+void locked_Graph::mark_output_changed() const
+{
+  dot::GraphPtr::unlocked_type::wat{tracker_->graph_ptr().item()}->mark_items_changed();
+  for (std::weak_ptr<GraphTracker> const& weak_graph_tracker : graph_trackers_)
+  {
+    std::shared_ptr<GraphTracker> graph_tracker = weak_graph_tracker.lock();
+    // The dot::GraphItem of a subgraph in which nothing changed can write its previous output again.
+    if (graph_tracker && graph_tracker->clear_output_dirty())
+      graph_tracker->tracked_rat()->mark_output_changed();
+  }
+}
+
 void locked_Graph::write_dot(std::ostream& os) const
 {
-  call_initialize_on_items();
+  if (tracker_->subtree_dirty())
+  {
+    // Clear the flag first, so that a concurrent change marks it dirty again.
+    tracker_->clear_subtree_dirty();
+    call_initialize_on_items();
+  }
+  if (tracker_->clear_output_dirty())
+    mark_output_changed();
   dot::GraphPtr::unlocked_type::rat{tracker_->graph_ptr().item()}->write_dot(os);
 }
 
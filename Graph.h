@@ -1,11 +1,20 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "MemoryRegionOwner.h"
 #include "Item.h"
+#include "ChildSlots.h"
 #include "dot/Graph.h"
 #include "threadsafe/ObjectTracker.h"
+#include <atomic>
+#include <map>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <utility>
 #ifdef CWDEBUG
 #include "debug_ostream_operators.h"
 #include "utils/has_print_on.h"
@@ -23,6 +32,8 @@ class GraphTracker;
 class NodeTracker;
 class locked_Graph;
 class Graph;
+class IndexedContainerSet;
+struct IndexTypeLabel;
 
 // GraphTracker objects can only be created by calling the static GraphTracker::create,
 // which uses std::make_shared<GraphTracker> to create it.
@@ -39,6 +50,19 @@ class GraphTracker final : public threadsafe::ObjectTracker<Graph, locked_Graph,
 {
  private:
   dot::GraphPtr graph_ptr_;     // Unique pointer to the corresponding dot::GraphItem.
+  size_t parent_slot_ = ChildSlots<GraphTracker>::no_slot;     // The slot of this tracker in the graph_trackers_ of the parent graph; only accessed while that graph is locked.
+  std::atomic<bool> attributes_dirty_ = true;                  // Set when item_attributes must be called (again) before writing the dot file.
+  std::atomic<bool> subtree_dirty_ = true;                     // Set when this graph, or anything that it contains, must be initialized.
+  std::atomic<bool> elements_dirty_ = true;                    // Set when an element of an array of this (root) graph must be initialized.
+  std::atomic<bool> output_dirty_ = true;                      // Set when the output of this graph changed since it was last written.
+
+  // The tracker of the parent graph, used to mark the graphs above this one dirty without locking them.
+  using parent_t = threadsafe::Unlocked<std::weak_ptr<GraphTracker>, threadsafe::policy::Primitive<std::mutex>>;
+  parent_t parent_;
+
+ private:
+  // Set subtree_dirty_ and output_dirty_; returns true if at least one of them wasn't set yet.
+  bool mark_dirty();
 
  public:
   GraphTracker(utils::Badge<threadsafe::TrackedObject<Graph, GraphTracker>>, Graph& graph);
@@ -50,6 +74,42 @@ class GraphTracker final : public threadsafe::ObjectTracker<Graph, locked_Graph,
     graph_ptr_w->attribute_list().add({"what", what});
   }
 
+  void set_parent_slot(size_t parent_slot) { parent_slot_ = parent_slot; }
+  size_t parent_slot() const { return parent_slot_; }
+
+  // Set by the parent graph when this graph is added to it, reset when it is removed again.
+  void set_parent(std::weak_ptr<GraphTracker> parent) { *parent_t::wat{parent_} = std::move(parent); }
+
+  // Mark that item_attributes must be called (again) for the tracked item.
+  void mark_attributes_dirty()
+  {
+    attributes_dirty_.store(true, std::memory_order_relaxed);
+    mark_subtree_dirty();
+  }
+  // Return true if the tracked item must be initialized; this can be called without locking the tracked item.
+  bool attributes_dirty() const { return attributes_dirty_.load(std::memory_order_relaxed); }
+  // Called by initialize_item before calling item_attributes.
+  void clear_attributes_dirty() { attributes_dirty_.store(false, std::memory_order_relaxed); }
+
+  // Mark this graph and all graphs above it as containing something that must be initialized, or written again.
+  void mark_subtree_dirty();
+  // Return true if this graph, or anything that it contains, must be initialized; this can be called without locking the tracked item.
+  bool subtree_dirty() const { return subtree_dirty_.load(); }
+  // Called by initialize_item before initializing anything in the graph.
+  void clear_subtree_dirty() { subtree_dirty_.store(false); }
+
+  // Mark that an element of one of the arrays of this root graph must be initialized.
+  void mark_elements_dirty()
+  {
+    elements_dirty_.store(true);
+    mark_subtree_dirty();
+  }
+  bool elements_dirty() const { return elements_dirty_.load(); }
+  void clear_elements_dirty() { elements_dirty_.store(false); }
+
+  // Clear the flag that is set by mark_subtree_dirty, until the dot file is written; returns true if it was set.
+  bool clear_output_dirty() { return output_dirty_.exchange(false); }
+
   // Accessors.
   dot::GraphPtr const& graph_ptr() const { return graph_ptr_; }
   dot::GraphPtr& graph_ptr() { return graph_ptr_; }
@@ -66,9 +126,14 @@ class locked_Graph : public ItemTemplate<Graph, GraphTracker>, public MemoryRegi
   using threadsafe::TrackedObject<Graph, GraphTracker>::tracker_;
 
  private:
-  std::vector<std::weak_ptr<NodeTracker>> node_trackers_;               // The nodes that are added to this graph.
-  std::vector<std::weak_ptr<GraphTracker>> graph_trackers_;             // The subgraphs that are added to this graph.
-  std::vector<std::weak_ptr<MemoryRegionOwnerTracker>> array_trackers_; // Array objects that were added to this (root) graph.
+  ChildSlots<NodeTracker> node_trackers_;                               // The nodes that are added to this graph.
+  ChildSlots<GraphTracker> graph_trackers_;                             // The subgraphs that are added to this graph.
+  std::vector<MemoryRegionOwner::handle_type> array_handles_;           // Array objects that were added to this (root) graph, by slot; a removed array leaves a null handle.
+  std::vector<size_t> free_array_slots_;                                // The slots of array_handles_ that can be reused.
+  // The cluster subgraphs of the Array and Vector objects of this (root) graph, per index type and label prefix.
+  // The containers share the ownership, so that a set survives the root graph as long as it contains containers.
+  using indexed_container_sets_key_type = std::pair<IndexTypeLabel const*, char const*>;
+  std::map<indexed_container_sets_key_type, std::shared_ptr<IndexedContainerSet>> indexed_container_sets_;
 
  public:
   // Instantiating the destructor will cause the instantiation of the destructor of graph_trackers_
@@ -97,14 +162,25 @@ class locked_Graph : public ItemTemplate<Graph, GraphTracker>, public MemoryRegi
   void remove_node(std::shared_ptr<NodeTracker>&& node_tracker);
   void add_graph(std::weak_ptr<GraphTracker> graph_tracker);
   void remove_graph(std::shared_ptr<GraphTracker>&& graph_tracker);
-  void add_array(std::weak_ptr<MemoryRegionOwnerTracker> weak_array_tracker);
-  void remove_array(std::shared_ptr<MemoryRegionOwnerTracker>&& array_tracker);
+  static constexpr size_t no_array_slot = std::numeric_limits<size_t>::max();
+  // Add an array and return its slot, which must be passed to remove_array.
+  size_t add_array(MemoryRegionOwner::handle_type array_handle);
+  void remove_array(MemoryRegionOwner::handle_type array_handle, size_t array_slot);
+  // Return the set of the containers with index type index_type_label and label_prefix, creating it if it doesn't exist yet.
+  // This must be called on a root graph.
+  std::shared_ptr<IndexedContainerSet> get_indexed_container_set(IndexTypeLabel const* index_type_label, char const* label_prefix);
   void write_dot(std::ostream& os) const;
 
   void initialize_item() override;
 
  private:
   void call_initialize_on_items() const;
+  // Tell the dot::GraphItem of this graph, and of every subgraph whose output changed, to write its items again.
+  void mark_output_changed() const;
+  // Unlink a child from this graph, after it was erased from node_trackers_ or graph_trackers_.
+  void detach_node(NodeTracker& node_tracker);
+  void detach_graph(GraphTracker& graph_tracker);
+  void detach_all_children();
 
   void on_memory_region_usage(MemoryRegion const& UNUSED_ARG(owner_memory_region),
       MemoryRegion const& UNUSED_ARG(item_memory_region), dot::NodePtr* UNUSED_ARG(node_ptr_ptr)) override
@@ -135,3 +211,5 @@ class Graph : public threadsafe::UnlockedTrackedObject<locked_Graph, dot::ItemLo
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
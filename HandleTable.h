@@ -0,0 +1,157 @@
+#pragma once
+
+#include "threadsafe/threadsafe.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include "debug.h"
+#ifdef CWDEBUG
+#include "utils/has_print_on.h"
+#endif
+
+namespace cppgraphviz {
+#ifdef CWDEBUG
+using utils::has_print_on::operator<<;
+#endif
+
+// A table of generation-tagged handles to objects of type T.
+//
+// A Handle consists of the index of a slot and the generation of that slot at the time
+// the handle was allocated. Releasing a handle increments the generation of its slot,
+// which invalidates all copies of that handle. Released slots are reused in FIFO order.
+//
+// Unlike locking a std::weak_ptr, looking up a handle only reads the slot; it never
+// writes to memory that is shared with other threads. The slots are allocated in chunks
+// that are never freed (until the table is destructed), so looking up a stale handle is
+// always safe.
+//
+// Note that, also unlike a std::weak_ptr, a handle does not keep the object alive while
+// it is being used: the caller must make sure by other means that the object is not
+// destructed concurrently.
+template<typename T>
+class HandleTable
+{
+ public:
+  class Handle
+  {
+   private:
+    uint32_t index_ = 0;
+    uint32_t generation_ = 0;           // Zero is never the generation of a slot, so a default constructed Handle is invalid.
+
+    friend class HandleTable;
+    Handle(uint32_t index, uint32_t generation) : index_(index), generation_(generation) { }
+
+   public:
+    Handle() = default;
+
+    bool is_null() const { return generation_ == 0; }
+
+    friend bool operator==(Handle const& lhs, Handle const& rhs) = default;
+
+#ifdef CWDEBUG
+    void print_on(std::ostream& os) const
+    {
+      os << '#' << index_ << '.' << generation_;
+    }
+#endif
+  };
+
+ private:
+  static constexpr int chunk_shift = 12;
+  static constexpr uint32_t chunk_size = uint32_t{1} << chunk_shift;
+  static constexpr size_t max_chunks = 4096;                            // Room for 16777216 slots.
+
+  struct Slot
+  {
+    std::atomic<uint32_t> generation_ = 0;
+    std::atomic<T*> object_ = nullptr;
+  };
+
+  struct FreeSlots
+  {
+    uint32_t number_of_slots_ = 0;      // The number of slots that were ever used.
+    std::deque<uint32_t> free_list_;    // The indices of the released slots, oldest first.
+  };
+  using free_slots_t = threadsafe::Unlocked<FreeSlots, threadsafe::policy::Primitive<std::mutex>>;
+
+  std::array<std::atomic<Slot*>, max_chunks> chunks_{};
+  free_slots_t free_slots_;
+
+  Slot& slot(uint32_t index) const
+  {
+    return chunks_[index >> chunk_shift].load(std::memory_order_acquire)[index & (chunk_size - 1)];
+  }
+
+ public:
+  HandleTable() = default;
+  HandleTable(HandleTable const&) = delete;
+
+  ~HandleTable()
+  {
+    for (std::atomic<Slot*>& chunk : chunks_)
+      delete[] chunk.load(std::memory_order_relaxed);
+  }
+
+  // Return a new handle to object.
+  Handle allocate(T* object)
+  {
+    uint32_t index;
+    {
+      typename free_slots_t::wat free_slots_w(free_slots_);
+      if (!free_slots_w->free_list_.empty())
+      {
+        index = free_slots_w->free_list_.front();
+        free_slots_w->free_list_.pop_front();
+      }
+      else
+      {
+        index = free_slots_w->number_of_slots_++;
+        // Increase max_chunks if this fires.
+        ASSERT((index >> chunk_shift) < max_chunks);
+        if ((index & (chunk_size - 1)) == 0)
+          chunks_[index >> chunk_shift].store(new Slot[chunk_size], std::memory_order_release);
+      }
+    }
+    Slot& new_slot = slot(index);
+    uint32_t generation = new_slot.generation_.load(std::memory_order_relaxed) + 1;
+    if (generation == 0)
+      generation = 1;
+    new_slot.object_.store(object, std::memory_order_relaxed);
+    new_slot.generation_.store(generation, std::memory_order_release);
+    return {index, generation};
+  }
+
+  // Invalidate handle and all its copies.
+  void release(Handle handle)
+  {
+    Slot& old_slot = slot(handle.index_);
+    // Paranoia check: releasing a handle twice?
+    ASSERT(old_slot.generation_.load(std::memory_order_relaxed) == handle.generation_);
+    // Generation zero is skipped when the slot is reused.
+    old_slot.generation_.store(handle.generation_ + 1, std::memory_order_release);
+    old_slot.object_.store(nullptr, std::memory_order_relaxed);
+    typename free_slots_t::wat free_slots_w(free_slots_);
+    free_slots_w->free_list_.push_back(handle.index_);
+  }
+
+  // Let handle refer to object from now on; used when the object is moved.
+  void set(Handle handle, T* object)
+  {
+    slot(handle.index_).object_.store(object, std::memory_order_relaxed);
+  }
+
+  // Return the object that handle refers to, or nullptr if handle was released (or is null).
+  T* get(Handle handle) const
+  {
+    if (handle.is_null())
+      return nullptr;
+    Slot const& handle_slot = slot(handle.index_);
+    if (handle_slot.generation_.load(std::memory_order_acquire) != handle.generation_)
+      return nullptr;
+    return handle_slot.object_.load(std::memory_order_relaxed);
+  }
+};
+
+} // namespace cppgraphviz
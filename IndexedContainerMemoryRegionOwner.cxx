@@ -1,6 +1,7 @@
 #include "sys.h"
 #include "Array.h"
-#include "utils/pointer_hash.h"
+#include <algorithm>
+#include <utility>
 
 namespace cppgraphviz {
 
@@ -12,71 +13,56 @@ char const* const vector_label_prefix = "Vector[";
 
 void IndexedContainerMemoryRegionOwner::initialize(std::weak_ptr<GraphTracker> const& root_graph,
     char const* label_prefix,
-    std::type_info const& index_type_info, std::string_view demangled_index_type_name)
+    IndexTypeLabel const* index_type_label)
 {
   {
     dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
     table_node_ptr_w->add_attribute({"what", "IndexedContainerMemoryRegionOwner::table_node_ptr_"});
-    // Instead of copying elements, we create new dot::NodePtr objects and use
-    // those temporarily until they can be overwritten later in on_memory_region_usage.
-    table_node_ptr_w->copy_elements([](size_t i){
-          dot::NodePtr node_ptr;
-          dot::NodePtr::unlocked_type::wat{node_ptr.item()}->add_attribute({"what", "default NodePtr for Array/Vector"});
-          return node_ptr;
-        }, number_of_elements_);
+    // The rows are not stored in the table node, but taken from id_to_node_map_ when needed.
+    link_table_rows(table_node_ptr_w);
   }
   std::shared_ptr<GraphTracker> root_graph_tracker = root_graph.lock();
   // Paranoia check.
   ASSERT(root_graph_tracker);
-  // Create a key that is unique for a _Index / root_graph pair, also discriminating between different label prefixes.
-  uint64_t key = utils::pointer_hash_combine(index_type_info.hash_code(), root_graph_tracker.get());
-  key = utils::pointer_hash_combine(key, label_prefix);
   {
-    indexed_container_sets_t::wat indexed_container_sets_w{indexed_container_sets_};
-    auto ibp = indexed_container_sets_w->try_emplace(key, "IndexedContainerMemoryRegionOwner::indexed_container_sets_");
-    IndexedContainerSet& indexed_container_set = ibp.first->second;
-    if (ibp.second)
-    {
-      // We should never get here when no demangled_index_type_name was passed.
-      ASSERT(demangled_index_type_name.size() != 0);
-      dot::GraphPtr::unlocked_type::wat{root_graph_tracker->graph_ptr().item()}->insert(indexed_container_set);
-      ibp.first->second.set_label(label_prefix + std::string(demangled_index_type_name) + "]");
-    }
-    indexed_container_set.add_container(table_node_ptr_, dot::TableNodePtr::unlocked_type::crat{table_node_ptr_.item()});
+    auto root_graph_w = root_graph_tracker->tracked_wat();
+    // The interned index_type_label identifies _Index; the root graph owns the container sets.
+    indexed_container_set_ = root_graph_w->get_indexed_container_set(index_type_label, label_prefix);
+    // Add this array to the root graph, so that it will call initialize before writing the dot file.
+    array_slot_ = root_graph_w->add_array(handle_);
   }
-  // Add this array to the root graph, so that it will call initialize before writing the dot file.
-  root_graph_tracker->tracked_wat()->add_array(MemoryRegionOwner::tracker_);
+  indexed_container_set_->add_container(table_node_ptr_, dot::TableNodePtr::unlocked_type::crat{table_node_ptr_.item()});
 }
 
 // This constructor is used by Array:
 // begin_ is initialized immediately and get_begin_ isn't used (must be/remain nullptr).
 // number_of_elements_ is initialized and never changes, and get_number_of_elements_ isn't used (must be/remain nullptr).
 IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(std::weak_ptr<GraphTracker> const& root_graph,
-    char* begin, size_t element_size, size_t number_of_elements, std::type_info const& index_type_info,
-    std::string const& demangled_index_type_name, std::string_view what) :
-  MemoryRegionOwner({ begin, element_size * number_of_elements }),
+    char* begin, size_t element_size, size_t number_of_elements, IndexTypeLabel const* index_type_label,
+    std::string_view what) :
+  MemoryRegionOwner({ begin, element_size * number_of_elements }, MemoryRegionSource::Array),
   LabelNode(root_graph, what),
   begin_(begin), element_size_(element_size), number_of_elements_(number_of_elements),
   id_to_node_map_(number_of_elements_),
   get_begin_(nullptr), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(" << root_graph << ", " <<
-      (void*)begin << ", " << element_size << ", " << number_of_elements << ", index_type_info, \"" << what << "\")");
-  initialize(root_graph, array_label_prefix, index_type_info, demangled_index_type_name);
+      (void*)begin << ", " << element_size << ", " << number_of_elements << ", " << index_type_label->label_ << ", \"" << what << "\")");
+  initialize(root_graph, array_label_prefix, index_type_label);
 }
 
 // This constructor is used by Array, see above.
 IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(char* begin, size_t element_size, size_t number_of_elements,
-    std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what) :
-  MemoryRegionOwner({ begin, element_size * number_of_elements }),
+    IndexTypeLabel const* index_type_label, std::string_view what) :
+  MemoryRegionOwner({ begin, element_size * number_of_elements }, MemoryRegionSource::Array),
   LabelNode(what),
   begin_(begin), element_size_(element_size), number_of_elements_(number_of_elements),
   id_to_node_map_(number_of_elements_),
   get_begin_(nullptr), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(" <<
-      (void*)begin << ", " << element_size << ", " << number_of_elements << ", index_type_info, " <<
-      demangled_index_type_name << ", \"" << what << "\")");
+      (void*)begin << ", " << element_size << ", " << number_of_elements << ", " <<
+      index_type_label->label_ << ", \"" << what << "\")");
   // Not implemented; among others we'll have to get the root graph from the memory region owner that we're in now(?)
   ASSERT(false);
 }
@@ -87,32 +73,32 @@ IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(char* begin
 // set to nullptr (in order to use number_of_elements_) and be initialized later, after the whole vector has been constructed.
 IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(std::weak_ptr<GraphTracker> const& root_graph,
     size_t element_size, size_t initial_number_of_elements, get_begin_type get_begin,
-    std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what) :
+    IndexTypeLabel const* index_type_label, std::string_view what) :
   LabelNode(root_graph, what),
   begin_(nullptr), element_size_(element_size), number_of_elements_(initial_number_of_elements),
   id_to_node_map_(number_of_elements_),
   get_begin_(get_begin), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(" << root_graph << ", " <<
-      element_size << ", index_type_info, \"" << what << "\")");
-  initialize(root_graph, vector_label_prefix, index_type_info, demangled_index_type_name);
+      element_size << ", " << index_type_label->label_ << ", \"" << what << "\")");
+  initialize(root_graph, vector_label_prefix, index_type_label);
 }
 
 // This constructor is used by Array, see above.
 IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(
     threadsafe::LockFinalCopy<IndexedContainerMemoryRegionOwner> other,
     char* begin,
-    std::type_info const& index_type_info,
+    IndexTypeLabel const* index_type_label,
     std::string_view what) :
-  MemoryRegionOwner({ begin, other->element_size_ * other->number_of_elements_ }),
+  MemoryRegionOwner({ begin, other->element_size_ * other->number_of_elements_ }, MemoryRegionSource::Array),
   LabelNode(other, what),
   begin_(begin), element_size_(other->element_size_), number_of_elements_(other->number_of_elements_),
   id_to_node_map_(number_of_elements_),
   get_begin_(nullptr), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(IndexedContainerMemoryRegionOwner const& " <<
-      other.operator->() << ", " << (void*)begin << ", index_type_info, \"" << what << "\")");
-  initialize(root_graph_tracker(), array_label_prefix, index_type_info, "");
+      other.operator->() << ", " << (void*)begin << ", " << index_type_label->label_ << ", \"" << what << "\")");
+  initialize(root_graph_tracker(), array_label_prefix, index_type_label);
 }
 
 // This constructor is used by Array, see above.
@@ -121,25 +107,35 @@ IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(threadsafe:
   MemoryRegionOwner(*orig, { begin, orig->element_size_ * orig->number_of_elements_ }),
   LabelNode(std::move(orig), what),
   begin_(begin), element_size_(orig->element_size_), number_of_elements_(orig->number_of_elements_),
-  table_node_ptr_(std::move(orig->table_node_ptr_)), id_to_node_map_(std::move(orig->id_to_node_map_)),
+  table_node_ptr_(std::move(orig->table_node_ptr_)), indexed_container_set_(std::move(orig->indexed_container_set_)),
+  array_slot_(std::exchange(orig->array_slot_, locked_Graph::no_array_slot)),   // The handle was taken over too.
   get_begin_(nullptr), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice,
       "IndexedContainerMemoryRegionOwner(IndexedContainerMemoryRegionOwner&& " << orig.operator->() << ", " <<
       (void*)begin << ", \"" << what << "\") [" << this << "]");
+  // A moved container has no table node and no rows.
+  if (indexed_container_set_)
+  {
+    // The table node that was taken over reads the rows from id_to_node_map_ while rendering;
+    // take over the rows while it is locked and let it refer to those of this container.
+    dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+    id_to_node_map_ = std::move(orig->id_to_node_map_);
+    link_table_rows(table_node_ptr_w);
+  }
 }
 
 // This constructor is used by Vector, see above.
 IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(threadsafe::LockFinalCopy<IndexedContainerMemoryRegionOwner> other,
-    std::type_info const& index_type_info, std::string_view what) :
+    IndexTypeLabel const* index_type_label, std::string_view what) :
   LabelNode(other, what),
   begin_(nullptr), element_size_(other->element_size_), number_of_elements_(other->get_number_of_elements_(other.operator->())),
   id_to_node_map_(number_of_elements_),
   get_begin_(other->get_begin_), get_number_of_elements_(nullptr)
 {
   DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(IndexedContainerMemoryRegionOwner const& " <<
-      other.operator->() << ", index_type_info, \"" << what << "\")");
-  initialize(root_graph_tracker(), vector_label_prefix, index_type_info, "");
+      other.operator->() << ", " << index_type_label->label_ << ", \"" << what << "\")");
+  initialize(root_graph_tracker(), vector_label_prefix, index_type_label);
 }
 
 // This constructor is used by Vector, see above.
@@ -147,13 +143,65 @@ IndexedContainerMemoryRegionOwner::IndexedContainerMemoryRegionOwner(threadsafe:
     std::string_view what) :
   LabelNode(std::move(other), what),
   begin_(nullptr), element_size_(other->element_size_), number_of_elements_(other->get_number_of_elements_(other.operator->())),
-  table_node_ptr_(std::move(other->table_node_ptr_)), id_to_node_map_(std::move(other->id_to_node_map_)),
+  table_node_ptr_(std::move(other->table_node_ptr_)), indexed_container_set_(std::move(other->indexed_container_set_)),
   get_begin_(other->get_begin_), get_number_of_elements_(nullptr)
 {
   ASSERT(get_number_of_elements_);
   DoutEntering(dc::notice,
       "IndexedContainerMemoryRegionOwner(IndexedContainerMemoryRegionOwner&& " << other.operator->() <<
       ", \"" << what << "\") [" << this << "]");
+  // A moved container has no table node and no rows.
+  if (indexed_container_set_)
+  {
+    // The table node that was taken over reads the rows from id_to_node_map_ while rendering;
+    // take over the rows while it is locked and let it refer to those of this container.
+    dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+    id_to_node_map_ = std::move(other->id_to_node_map_);
+    link_table_rows(table_node_ptr_w);
+  }
+}
+
+IndexedContainerMemoryRegionOwner::~IndexedContainerMemoryRegionOwner()
+{
+  DoutEntering(dc::notice, "~IndexedContainerMemoryRegionOwner() [" << this << "]");
+  // Remove this container from the arrays of the root graph, unless it was moved.
+  if (array_slot_ != locked_Graph::no_array_slot)
+    if (std::shared_ptr<GraphTracker> root_graph_tracker = root_graph_tracker().lock())
+      root_graph_tracker->tracked_wat()->remove_array(handle(), array_slot_);
+  // Remove the whole table at once, instead of detaching the elements one by one while they are destroyed.
+  // A moved container no longer has a table node.
+  if (indexed_container_set_)
+  {
+    indexed_container_set_->remove_container(table_node_ptr_);
+    // The table node might still be referenced from elsewhere; it may no longer refer to id_to_node_map_.
+    dot::TableNodePtr::unlocked_type::wat{table_node_ptr_.item()}->link_rows([]{ return size_t{0}; }, {});
+  }
+}
+
+void IndexedContainerMemoryRegionOwner::link_table_rows(dot::TableNodePtr::unlocked_type::wat& table_node_ptr_w)
+{
+  // These are only called while the table node is locked; id_to_node_map_ is only changed while it is write locked.
+  table_node_ptr_w->link_rows(
+      [this]{ return id_to_node_map_.size(); },
+      [this](size_t index) -> dot::TableElement {
+        std::shared_ptr<NodeTracker> node_tracker = id_to_node_map_[index].lock();
+        if (!node_tracker)
+          return dot::NodePtr{default_row()};
+        return node_tracker->node_ptr();
+      });
+}
+
+void IndexedContainerMemoryRegionOwner::detach_elements(size_t first)
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::detach_elements(" << first << ") [" << this << "]");
+
+  // Only a Vector can lose elements.
+  ASSERT(!begin_);
+  std::erase_if(pending_elements_, [first](PendingElement const& pending_element){ return pending_element.index_ >= first; });
+  if (first >= id_to_node_map_.size())
+    return;
+  dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+  id_to_node_map_.resize(first);
 }
 
 void IndexedContainerMemoryRegionOwner::on_memory_region_usage(MemoryRegion const& owner_memory_region,
@@ -171,11 +219,17 @@ void IndexedContainerMemoryRegionOwner::on_memory_region_usage(MemoryRegion cons
   else
   {
     // This is Vector.
-    begin = get_begin_(this);
-    // While resizing a vector get_begin_ might return the old memory region.
-    MemoryRegion first_element{const_cast<char*>(begin), element_size_};
-    if (!first_element.lays_within(owner_memory_region))
-      begin = owner_memory_region.begin();       // Assume a vector allocates a memory region that starts with the first elements :/
+    // While resizing a vector get_begin_ might still return the old buffer, but the elements
+    // are always constructed in the buffer that was allocated last.
+    if (item_memory_region.lays_within(current_allocation_))
+      begin = current_allocation_.begin();
+    else
+    {
+      begin = get_begin_(this);
+      MemoryRegion first_element{const_cast<char*>(begin), element_size_};
+      if (!first_element.lays_within(owner_memory_region))
+        begin = owner_memory_region.begin();     // Assume a vector allocates a memory region that starts with the first elements :/
+    }
   }
 
   char* item_begin = item_memory_region.begin();
@@ -183,50 +237,192 @@ void IndexedContainerMemoryRegionOwner::on_memory_region_usage(MemoryRegion cons
   ptrdiff_t offset = item_begin - begin;
   size_t index = offset / element_size_;
 
-  size_t number_of_elements;
-  if (begin_)
+  // An element that is moved during a relocation has no node_ptr_ptr (see Item(Item&&)).
+  bool relocating = !node_ptr_ptr && relocation_.old_buffer_.begin() && begin == current_allocation_.begin();
+  if (bulk_construction_ || relocating)
   {
-    // This is an Array.
-    number_of_elements = number_of_elements_;
-  }
-  else
-  {
-    // This is Vector.
-    if (get_number_of_elements_)
-    {
-      number_of_elements = get_number_of_elements_(this);
-      // vector::size() might not return the correct value yet.
-      if (number_of_elements <= index)
-        number_of_elements = index + 1;
-    }
-    else
-      number_of_elements = number_of_elements_;
-
-    if (id_to_node_map_.size() != number_of_elements)
-    {
-      id_to_node_map_.resize(number_of_elements);
-      dot::NodePtr node_ptr;
-      dot::NodePtr::unlocked_type::wat{node_ptr.item()}->add_attribute({"what", "default NodePtr for Vector"});
-      dot::TableNodePtr::unlocked_type::wat{table_node_ptr_.item()}->resize_copied_elements(number_of_elements, node_ptr);
-    }
+    // Add the element to the table node later, together with the other elements of this batch.
+    Dout(dc::notice, "Postponing element " << index << ".");
+    pending_elements_.push_back({index, item});
+    // Moved elements already have their root graph.
+    if (node_ptr_ptr)
+      item->set_root_graph_tracker(root_graph_tracker_);
+    return;
   }
 
+  size_t number_of_elements = required_number_of_elements(index);
   Dout(dc::notice, "index = " << index << "; number_of_elements = " << number_of_elements);
   ASSERT(0 <= index && index < number_of_elements);
 
   // node_ptr_ptr can't be nullptr, because if this is to be added to a table node then
   // the item has to be a dot::NodeItem (still being constructed though).
   ASSERT(node_ptr_ptr);
-  dot::NodePtr& node_ptr = *node_ptr_ptr;
-  dot::TableNodePtr::unlocked_type::wat{table_node_ptr_.item()}->replace_element(index, node_ptr);
   // And item has to be Node.
   Node* node = static_cast<Node*>(item);
   std::weak_ptr<NodeTracker> weak_node_tracker = *node;
   Dout(dc::notice, "Mapping id_to_node_map_[" << index << "] = " << weak_node_tracker);
-  id_to_node_map_[index] = weak_node_tracker;
+  {
+    // The table node reads id_to_node_map_ while rendering.
+    dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+    if (id_to_node_map_.size() != number_of_elements)
+      resize_table(table_node_ptr_w, number_of_elements);
+    id_to_node_map_[index] = std::move(weak_node_tracker);
+  }
 
   // Array elements should be created without root graph. They get that when they are copied into the array, here.
   item->set_root_graph_tracker(root_graph_tracker_);
+  // The new element must be initialized before the next dot file is written.
+  mark_elements_dirty();
+}
+
+void IndexedContainerMemoryRegionOwner::allocated(utils::Badge<TrackingAllocator>, MemoryRegion const& allocation)
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::allocated(" << allocation << ") [" << this << "]");
+
+  // If the elements of the vector are in the previous buffer, then the vector is growing (or shrinking)
+  // and is about to move those elements into the new buffer.
+  size_t number_of_elements = get_number_of_elements_ ? get_number_of_elements_(this) : 0;
+  if (number_of_elements > 0 && MemoryRegion{const_cast<char*>(get_begin_(this)), element_size_}.lays_within(current_allocation_))
+  {
+    // Paranoia check: the previous relocation should have been committed (or rolled back) by now.
+    ASSERT(!relocation_.old_buffer_.begin());
+    relocation_.old_buffer_.critical_area_assign(current_allocation_);
+    relocation_.number_of_elements_ = number_of_elements;
+    pending_elements_.reserve(number_of_elements);
+  }
+  current_allocation_.critical_area_assign(allocation);
+}
+
+void IndexedContainerMemoryRegionOwner::deallocating(utils::Badge<TrackingAllocator>, MemoryRegion const& allocation)
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::deallocating(" << allocation << ") [" << this << "]");
+
+  if (!relocation_.old_buffer_.begin())
+    return;
+
+  if (allocation == relocation_.old_buffer_)
+    commit_relocation();
+  else if (allocation == current_allocation_)
+  {
+    // Moving the elements failed (threw) and the vector keeps using the old buffer.
+    current_allocation_.critical_area_assign(relocation_.old_buffer_);
+    relocation_.old_buffer_.critical_area_assign({});
+    pending_elements_.clear();
+  }
+}
+
+void IndexedContainerMemoryRegionOwner::commit_relocation()
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::commit_relocation() [" << this << "]");
+
+  // Normally all elements are moved, but the vector might also have been shrunk (e.g. by shrink_to_fit).
+  ASSERT(pending_elements_.size() <= relocation_.number_of_elements_ || bulk_construction_);
+
+  add_pending_elements();
+  relocation_.old_buffer_.critical_area_assign({});
+}
+
+void IndexedContainerMemoryRegionOwner::end_bulk_construction()
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::end_bulk_construction() [" << this << "]");
+
+  ASSERT(bulk_construction_);
+  add_pending_elements();
+  bulk_construction_ = false;
+}
+
+size_t IndexedContainerMemoryRegionOwner::required_number_of_elements(size_t index) const
+{
+  if (begin_)
+  {
+    // This is an Array.
+    return number_of_elements_;
+  }
+
+  // This is Vector.
+  if (!get_number_of_elements_)
+    return number_of_elements_;
+
+  size_t number_of_elements = get_number_of_elements_(this);
+  // vector::size() might not return the correct value yet.
+  if (number_of_elements <= index)
+    number_of_elements = index + 1;
+  return number_of_elements;
+}
+
+void IndexedContainerMemoryRegionOwner::resize_table(dot::TableNodePtr::unlocked_type::wat& table_node_ptr_w,
+    size_t number_of_elements)
+{
+  // Only a Vector can change its size.
+  ASSERT(!begin_);
+  // Grow geometrically, so that a loop of push_back's only reallocates id_to_node_map_ a logarithmic number of times.
+  if (number_of_elements > id_to_node_map_.capacity())
+    id_to_node_map_.reserve(std::max(number_of_elements, 2 * id_to_node_map_.capacity()));
+  // New rows show the default row until their element is added.
+  // This also shrinks the table, when the vector lost elements without calling detach_elements first.
+  id_to_node_map_.resize(number_of_elements);
+}
+
+//static
+dot::NodePtr const& IndexedContainerMemoryRegionOwner::default_row()
+{
+  // Shared by all tables; this node is never changed after it is created.
+  static dot::NodePtr const s_default_row = []{
+    dot::NodePtr node_ptr;
+    dot::NodePtr::unlocked_type::wat{node_ptr.item()}->add_attribute({"what", "default NodePtr for Array/Vector"});
+    return node_ptr;
+  }();
+  return s_default_row;
+}
+
+void IndexedContainerMemoryRegionOwner::add_pending_elements()
+{
+  DoutEntering(dc::notice, "IndexedContainerMemoryRegionOwner::add_pending_elements() [" << this << "]");
+
+  if (pending_elements_.empty())
+    return;
+
+  size_t max_index = 0;
+  for (PendingElement const& pending_element : pending_elements_)
+    max_index = std::max(max_index, pending_element.index_);
+  size_t number_of_elements = required_number_of_elements(max_index);
+
+  // Update the table node in one go.
+  dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+  if (id_to_node_map_.size() != number_of_elements)
+    resize_table(table_node_ptr_w, number_of_elements);
+  for (PendingElement const& pending_element : pending_elements_)
+  {
+    ASSERT(pending_element.index_ < number_of_elements);
+    // The elements are fully constructed by now and have to be Node (see on_memory_region_usage).
+    Node* node = static_cast<Node*>(pending_element.item_);
+    std::weak_ptr<NodeTracker> weak_node_tracker = *node;
+    // A moved element takes its NodeTracker with it.
+    ASSERT(!weak_node_tracker.expired());
+    id_to_node_map_[pending_element.index_] = std::move(weak_node_tracker);
+  }
+  pending_elements_.clear();
+  // The new elements must be initialized before the next dot file is written.
+  mark_elements_dirty();
+}
+
+void IndexedContainerMemoryRegionOwner::mark_elements_dirty()
+{
+  std::shared_ptr<GraphTracker> root_graph_tracker = root_graph_tracker_.lock();
+  if (root_graph_tracker)
+    root_graph_tracker->mark_elements_dirty();
+}
+
+void IndexedContainerMemoryRegionOwner::set_table_attribute(dot::Attribute&& attribute)
+{
+  dot::TableNodePtr::unlocked_type::wat table_node_ptr_w{table_node_ptr_.item()};
+  table_node_ptr_w->attribute_list().remove(attribute);
+  table_node_ptr_w->add_attribute(std::move(attribute));
+}
+
+size_t IndexedContainerMemoryRegionOwner::elided_rows() const
+{
+  return dot::TableNodePtr::unlocked_type::crat{table_node_ptr_.item()}->elided_rows();
 }
 
 void IndexedContainerMemoryRegionOwner::call_initialize_on_elements()
@@ -238,12 +434,10 @@ void IndexedContainerMemoryRegionOwner::call_initialize_on_elements()
     Dout(dc::notice, "index = " << index);
     auto node_tracker = id_to_node_map_[index].lock();
     ++index;
-    if (node_tracker)
+    // Don't lock elements whose attributes didn't change.
+    if (node_tracker && node_tracker->attributes_dirty())
       node_tracker->tracked_wat()->initialize_item();
   });
 }
 
-//static
-IndexedContainerMemoryRegionOwner::indexed_container_sets_t IndexedContainerMemoryRegionOwner::indexed_container_sets_;
-
 } // namespace cppgraphviz
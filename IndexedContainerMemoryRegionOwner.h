@@ -4,6 +4,7 @@
 #include "MemoryRegionOwner.h"
 #include "Graph.h"
 #include "LabelNode.h"
+#include "get_index_label.h"
 #include "threadsafe/threadsafe.h"
 #include <vector>
 #include <map>
@@ -11,6 +12,8 @@
 
 namespace cppgraphviz {
 
+class TrackingAllocator;
+
 class IndexedContainerMemoryRegionOwner : public MemoryRegionOwner, public LabelNode
 {
  public:
@@ -22,27 +25,53 @@ class IndexedContainerMemoryRegionOwner : public MemoryRegionOwner, public Label
   size_t const element_size_;           // Element stride.
   size_t const number_of_elements_;     // The size() of the array.
   dot::TableNodePtr table_node_ptr_;
-  std::vector<std::weak_ptr<NodeTracker>> id_to_node_map_; // Map index to the tracker of the associated Node.
-  using indexed_container_sets_container_type = std::map<uint64_t, IndexedContainerSet>;
-  using indexed_container_sets_t = threadsafe::Unlocked<indexed_container_sets_container_type, threadsafe::policy::Primitive<std::mutex>>;
-  static indexed_container_sets_t indexed_container_sets_;
+  std::shared_ptr<IndexedContainerSet> indexed_container_set_;  // The set that table_node_ptr_ was added to (see locked_Graph::get_indexed_container_set).
+  size_t array_slot_ = locked_Graph::no_array_slot;             // The slot of handle() in the root graph, see locked_Graph::add_array.
+  std::vector<std::weak_ptr<NodeTracker>> id_to_node_map_; // Map index to the tracker of the associated Node. These are also the rows of table_node_ptr_.
 
  protected:
   // We can't use virtual functions because these are already needed while we're still constructing Vector.
   get_begin_type get_begin_;
   get_number_of_elements_type get_number_of_elements_;
 
+ private:
+  // Used by Vector: the buffer that was allocated last by its TrackingAllocator.
+  // This is where the elements are constructed, also while the vector is being resized.
+  MemoryRegion current_allocation_;
+
+  // Used by Vector: a relocation is in progress while the elements are moved from old_buffer_ to current_allocation_.
+  // The moved elements keep their index and NodeTracker, so the table node only has to be updated once, when the
+  // old buffer is deallocated, instead of finding the index and locking the table node for every element.
+  struct Relocation
+  {
+    MemoryRegion old_buffer_;           // The buffer that the elements are moved out of, or empty if there is no relocation in progress.
+    size_t number_of_elements_ = 0;     // The number of elements in old_buffer_.
+  };
+  Relocation relocation_;
+
+  // Set while a contiguous range of elements is being constructed, see begin_bulk_construction.
+  // The elements that are constructed right after the constructor of this object are always constructed in bulk.
+  bool bulk_construction_ = true;
+  // An element that was constructed (or moved) during a relocation or bulk construction,
+  // but that was not added to the table node yet.
+  struct PendingElement
+  {
+    size_t index_;                      // The index of the element.
+    Item* item_;                        // The Item base class of the element, as passed to on_memory_region_usage.
+  };
+  std::vector<PendingElement> pending_elements_;
+
  protected:
   // Used by Array.
   IndexedContainerMemoryRegionOwner(std::weak_ptr<GraphTracker> const& root_graph,
       char* begin, size_t element_size, size_t number_of_elements,
-      std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what);
+      IndexTypeLabel const* index_type_label, std::string_view what);
 
   IndexedContainerMemoryRegionOwner(char* begin, size_t element_size, size_t number_of_elements,
-      std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what);
+      IndexTypeLabel const* index_type_label, std::string_view what);
 
   IndexedContainerMemoryRegionOwner(threadsafe::LockFinalCopy<IndexedContainerMemoryRegionOwner> other,
-      char* begin, std::type_info const& index_type_info, std::string_view what);
+      char* begin, IndexTypeLabel const* index_type_label, std::string_view what);
 
   IndexedContainerMemoryRegionOwner(threadsafe::LockFinalMove<IndexedContainerMemoryRegionOwner> other,
       char* begin, std::string_view what);
@@ -51,25 +80,73 @@ class IndexedContainerMemoryRegionOwner : public MemoryRegionOwner, public Label
   IndexedContainerMemoryRegionOwner(std::weak_ptr<GraphTracker> const& root_graph,
       size_t element_size, size_t number_of_elements,
       get_begin_type get_begin,
-      std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what);
+      IndexTypeLabel const* index_type_label, std::string_view what);
 
   IndexedContainerMemoryRegionOwner(threadsafe::LockFinalCopy<IndexedContainerMemoryRegionOwner> other,
-      std::type_info const& index_type_info, std::string_view what);
+      IndexTypeLabel const* index_type_label, std::string_view what);
 
   IndexedContainerMemoryRegionOwner(threadsafe::LockFinalMove<IndexedContainerMemoryRegionOwner> other,
       std::string_view what);
 
+  // Construct the elements between these two calls in bulk: instead of adding every element to the table
+  // node when it is constructed, they are all added at once by end_bulk_construction.
+  // The constructors of IndexedContainerMemoryRegionOwner already begin a bulk construction; the constructor
+  // of the derived class must call end_bulk_construction once all elements are constructed.
+  void begin_bulk_construction() { ASSERT(!bulk_construction_); bulk_construction_ = true; }
+  void end_bulk_construction();
+
+  // Used by Vector: remove the elements with index first and higher from the table node in one go,
+  // before they are destroyed (by clear or a shrinking resize).
+  void detach_elements(size_t first);
+
+  // Used by Vector to bulk construct elements in member functions like resize and assign.
+  class BulkConstruction
+  {
+   private:
+    IndexedContainerMemoryRegionOwner* owner_;
+
+   public:
+    BulkConstruction(IndexedContainerMemoryRegionOwner* owner) : owner_(owner) { owner_->begin_bulk_construction(); }
+    ~BulkConstruction() { owner_->end_bulk_construction(); }
+  };
+
  public:
+  // Removes the table node from its IndexedContainerSet.
+  ~IndexedContainerMemoryRegionOwner();
+
   void call_initialize_on_elements();
 
+  // Set an attribute of the table node that represents this container, replacing any previous value.
+  // See dot::TableNodeItem::RowLimits for the attributes that limit the number of rows that are written.
+  void set_table_attribute(dot::Attribute&& attribute);
+
+  // The number of elements that were not written (individually) the last time the table node was written.
+  size_t elided_rows() const;
+
+  // Called by the TrackingAllocator of a Vector after allocating, respectively before deallocating, a buffer.
+  // Vector is not thread-safe; the caller is the thread that is (about to) construct elements in allocation.
+  void allocated(utils::Badge<TrackingAllocator>, MemoryRegion const& allocation);
+  void deallocating(utils::Badge<TrackingAllocator>, MemoryRegion const& allocation);
+
  private:
+  // Not thread-safe: the elements of a container may only be constructed by one thread at a time.
   void on_memory_region_usage(MemoryRegion const& owner_memory_region,
       MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr_ptr) override;
 
+  void commit_relocation();
+  size_t required_number_of_elements(size_t index) const;
+  // The placeholder of table rows whose element was not constructed (or moved into place) yet, or was destroyed.
+  static dot::NodePtr const& default_row();
+  void link_table_rows(dot::TableNodePtr::unlocked_type::wat& table_node_ptr_w);
+  // Passing table_node_ptr_w proves that the table node is locked, which is required to change id_to_node_map_.
+  void resize_table(dot::TableNodePtr::unlocked_type::wat& table_node_ptr_w, size_t number_of_elements);
+  void add_pending_elements();
+  // Let the root graph know that elements of this container must be initialized.
+  void mark_elements_dirty();
+
   void initialize(std::weak_ptr<GraphTracker> const& root_graph,
       char const* label_prefix,
-      std::type_info const& index_type_info,
-      std::string_view demangled_index_type_name);
+      IndexTypeLabel const* index_type_label);
 };
 
 } // namespace cppgraphviz
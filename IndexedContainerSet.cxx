@@ -17,7 +17,8 @@ namespace detail {
 
 void RankdirGraphData::set_rankdir(dot::RankDir rankdir) const
 {
-  owner_->rankdir_changed(rankdir);
+  if (owner_)
+    owner_->rankdir_changed(rankdir);
   dot::GraphItem::set_rankdir(rankdir);
 }
 
@@ -15,7 +15,7 @@ class RankdirGraphData : public dot::GraphItem
   using unlocked_type = threadsafe::Unlocked<RankdirGraphData, dot::ItemLockingPolicy>;
 
  private:
-  IndexedContainerSet* owner_;
+  IndexedContainerSet* owner_ = nullptr;
 
   void set_rankdir(dot::RankDir rankdir) const final;
 
@@ -57,6 +57,12 @@ class IndexedContainerSet
     outer_subgraph_w->set_owner(this);
   }
 
+  // The outer subgraph can outlive this object.
+  ~IndexedContainerSet()
+  {
+    detail::RankdirGraph::unlocked_type::wat{outer_subgraph_.item()}->set_owner(nullptr);
+  }
+
   IndexedContainerSet(std::string const& label, std::string_view what) : IndexedContainerSet(what)
   {
     set_label(label);
@@ -80,6 +86,12 @@ class IndexedContainerSet
     inner_subgraph_w->add(container);
   }
 
+  void remove_container(dot::TableNodePtr const& container)
+  {
+    dot::GraphPtr::unlocked_type::wat inner_subgraph_w{inner_subgraph_.item()};
+    inner_subgraph_w->remove(container);
+  }
+
   void add_to_graph(dot::GraphItem& graph_item);
   void remove_from_graph(dot::GraphItem& graph_item);
 
@@ -17,6 +17,20 @@ void Item::set_parent_graph_tracker(std::weak_ptr<GraphTracker> parent_graph_tra
   parent_graph_tracker_ = std::move(parent_graph_tracker);
 }
 
+void Item::mark_ancestors_dirty()
+{
+  std::shared_ptr<GraphTracker> parent_graph_tracker = parent_graph_tracker_.lock();
+  if (parent_graph_tracker)
+  {
+    parent_graph_tracker->mark_subtree_dirty();
+    return;
+  }
+  // The elements of an Array or Vector have no parent graph; they are initialized by the root graph.
+  std::shared_ptr<GraphTracker> root_graph_tracker = root_graph_tracker_.lock();
+  if (root_graph_tracker)
+    root_graph_tracker->mark_elements_dirty();
+}
+
 void Item::extract_root_graph()
 {
   std::shared_ptr<GraphTracker> parent_graph_tracker = parent_graph_tracker_.lock();
@@ -22,6 +22,8 @@ class Item
   using memory_region_to_owner_linker_type = MemoryRegionToOwnerLinkerSingleton::linker_type;
 
  protected:
+  // Unlike MemoryRegionOwner, graphs are not referred to by handle (see HandleTable):
+  // tracked_wat() and tracked_rat() need shared ownership of the tracker while it is locked.
   std::weak_ptr<GraphTracker> root_graph_tracker_;      // The root graph of this Item.
   std::weak_ptr<GraphTracker> parent_graph_tracker_;    // The graph that this Item was added to.
 
@@ -44,9 +46,7 @@ class Item
   // This is used by Node that is a member of a class.
   Item(Item* object)
   {
-    // Take the read-lock on the singleton.
-    memory_region_to_owner_linker_type::rat memory_region_to_owner_linker_r(MemoryRegionToOwnerLinkerSingleton::instance().linker_);
-    memory_region_to_owner_linker_r->inform_owner_of(object);     // This sets parent_graph_tracker_.
+    MemoryRegionToOwnerLinkerSingleton::instance().inform_owner_of(object);     // This sets parent_graph_tracker_.
     extract_root_graph();
   }
 
@@ -63,14 +63,9 @@ class Item
   //     { ... });         g0         null
   Item(std::weak_ptr<GraphTracker> const& root_graph_tracker, Item* object, dot::NodePtr* node_ptr_ptr = nullptr)
   {
-    bool inside_memory_region;
-    {
-      // Take the read-lock on the singleton.
-      memory_region_to_owner_linker_type::rat memory_region_to_owner_linker_r(MemoryRegionToOwnerLinkerSingleton::instance().linker_);
-      // This call sets parent_graph_tracker_ if object is found in a registered memory region
-      // (i.e. an indexed container that is added to the root graph).
-      inside_memory_region = memory_region_to_owner_linker_r->inform_owner_of(object, node_ptr_ptr);
-    }
+    // This call sets parent_graph_tracker_ if object is found in a registered memory region
+    // (i.e. an indexed container that is added to the root graph).
+    bool inside_memory_region = MemoryRegionToOwnerLinkerSingleton::instance().inform_owner_of(object, node_ptr_ptr);
 
     // A successful match with a memory region should set at least one of root_graph_tracker_ or parent_graph_tracker_.
     ASSERT(!inside_memory_region || root_graph_tracker_.use_count() > 0 || parent_graph_tracker_.use_count() > 0);
@@ -99,9 +94,7 @@ class Item
   Item(Item&& other) :
     root_graph_tracker_(std::move(other.root_graph_tracker_)), parent_graph_tracker_(std::move(other.parent_graph_tracker_))
   {
-    // Take the read-lock on the singleton.
-    memory_region_to_owner_linker_type::rat memory_region_to_owner_linker_r(MemoryRegionToOwnerLinkerSingleton::instance().linker_);
-    memory_region_to_owner_linker_r->inform_owner_of(this);     // This sets parent_graph_tracker_.
+    MemoryRegionToOwnerLinkerSingleton::instance().inform_owner_of(this);       // This sets parent_graph_tracker_.
     extract_root_graph();
   }
 
@@ -122,10 +115,16 @@ class Item
 
   std::weak_ptr<GraphTracker> const& root_graph_tracker() const { return root_graph_tracker_; }
 
+  // Add the attributes of item_attributes to the dot item, if they weren't added yet or changed since.
   virtual void initialize_item() = 0;
 
  protected:
+  // Override this to add attributes. It is called again when the item was marked dirty (see ItemTemplate::mark_attributes_dirty),
+  // with the attributes that were added before still in list: an existing attribute must be removed before it can be changed.
   virtual void item_attributes(dot::AttributeList& list) { }
+
+  // Mark the graphs that this item is in as containing an item that must be initialized.
+  void mark_ancestors_dirty();
 };
 
 template<typename TrackedType, typename Tracker>
@@ -151,6 +150,27 @@ class ItemTemplate : public threadsafe::TrackedObject<TrackedType, Tracker>, pub
 
   // Return the value of the "what" attribute.
   std::string get_what() const;
+
+ protected:
+  // Change the "what" attribute of an item that might already have been added to a graph.
+  void change_what(std::string_view what)
+  {
+    this->tracker_->set_what(what);
+    mark_attributes_dirty();
+  }
+
+  // Call this when something changed that item_attributes depends on,
+  // so that initialize_item calls item_attributes again before the next dot file is written.
+  void mark_attributes_dirty()
+  {
+    // A moved item no longer has a tracker.
+    if (!this->tracker_)
+      return;
+    this->tracker_->mark_attributes_dirty();
+    // A GraphTracker marks the graphs above it itself.
+    if constexpr (!std::is_same_v<Tracker, GraphTracker>)
+      mark_ancestors_dirty();
+  }
 };
 
 template<typename TrackedType, typename Tracker>
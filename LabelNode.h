@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "Node.h"
 
 namespace cppgraphviz {
@@ -13,6 +17,7 @@ class LabelNode : public Node
   {
     // Derive from LabelNode and override item_attributes to add a shape, color etc.
     // Call set_label to set the label, or derive from LabelNode and override item_attributes to add a label.
+    list.remove("label");
     if (label_.empty())
       list.add({"label", "<unknown LabelNode>"});
     else
@@ -44,7 +49,10 @@ class LabelNode : public Node
   void set_label(std::string const& label)
   {
     label_ = label;
+    mark_attributes_dirty();
   }
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
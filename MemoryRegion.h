@@ -7,6 +7,14 @@ namespace cppgraphviz {
 
 class MemoryRegionOwner;
 
+// The kind of object that registered a MemoryRegion.
+enum class MemoryRegionSource
+{
+  Class,                // The memory of an object derived from Class.
+  Array,                // The elements of an Array.
+  TrackingAllocator     // A buffer allocated by the TrackingAllocator of a Vector.
+};
+
 class MemoryRegion
 {
  private:
@@ -63,8 +71,9 @@ class MemoryRegion
     return os;
   }
 
-  // Accessor.
+  // Accessors.
   char* begin() const { return begin_; }
+  char const* end() const { return end_; }
 };
 
 } // namespace cppgraphviz
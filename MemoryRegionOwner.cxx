@@ -5,34 +5,42 @@
 
 namespace cppgraphviz {
 
-// Using this as type name feels more intuitive (better fits the pattern that I am used to).
-// Defined here because it can't be defined in (the header of) MemoryRegionOwner.
-using memory_region_to_owner_linker_type = MemoryRegionToOwnerLinkerSingleton::linker_type;
-
 void MemoryRegionOwner::register_new_memory_region(MemoryRegion memory_region)
 {
-  memory_region_to_owner_linker_type::wat memory_region_to_owner_linker_w(MemoryRegionToOwnerLinkerSingleton::instance().linker_);
-  memory_region_to_owner_linker_w->register_new_memory_region_for(memory_region, tracker_);
+  MemoryRegionToOwnerLinkerSingleton::instance().register_new_memory_region_for(memory_region, handle_, source_);
+}
+
+//static
+void MemoryRegionOwner::unregister_memory_region(MemoryRegion memory_region, MemoryRegionSource source)
+{
+  MemoryRegionToOwnerLinkerSingleton::instance().unregister_memory_region(memory_region, source);
 }
 
 //static
-void MemoryRegionOwner::unregister_memory_region(MemoryRegion memory_region)
+MemoryRegionOwner::handle_table_type& MemoryRegionOwner::handle_table()
+{
+  static handle_table_type s_handle_table;
+  return s_handle_table;
+}
+
+MemoryRegionOwner::MemoryRegionOwner() : handle_(handle_table().allocate(this))
 {
-  memory_region_to_owner_linker_type::wat memory_region_to_owner_linker_w(MemoryRegionToOwnerLinkerSingleton::instance().linker_);
-  memory_region_to_owner_linker_w->unregister_memory_region(memory_region);
 }
 
-MemoryRegionOwner::MemoryRegionOwner(MemoryRegion memory_region) : registered_memory_region_{memory_region}
+MemoryRegionOwner::MemoryRegionOwner(MemoryRegion memory_region, MemoryRegionSource source) :
+  registered_memory_region_{memory_region}, handle_(handle_table().allocate(this)), source_(source)
 {
   register_new_memory_region(registered_memory_region_);
 }
 
 MemoryRegionOwner::MemoryRegionOwner(MemoryRegionOwner&& orig, MemoryRegion memory_region) :
-  utils::TrackedObject<MemoryRegionOwnerTracker>(std::move(orig)),
-  registered_memory_region_{memory_region}
+  registered_memory_region_{memory_region}, handle_(orig.handle_), source_(orig.source_)
 {
+  // Take over the handle of orig, so that the memory regions that are still registered for orig are now owned by this object.
+  handle_table().set(handle_, this);
+  orig.handle_ = {};
   register_new_memory_region(registered_memory_region_);
-  MemoryRegionOwner::unregister_memory_region(orig.registered_memory_region_);
+  MemoryRegionOwner::unregister_memory_region(orig.registered_memory_region_, source_);
   // Stop the destructor from unregistering this memory region again.
   orig.registered_memory_region_.reset({});
 }
@@ -41,7 +49,10 @@ MemoryRegionOwner::~MemoryRegionOwner()
 {
   // Clean up.
   if (registered_memory_region_.begin())
-    MemoryRegionOwner::unregister_memory_region(registered_memory_region_);
+    MemoryRegionOwner::unregister_memory_region(registered_memory_region_, source_);
+  // Regions that are still registered for this object (if any) no longer have an owner.
+  if (!handle_.is_null())
+    handle_table().release(handle_);
 }
 
 } // namespace cppgraphviz
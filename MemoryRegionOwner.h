@@ -1,8 +1,8 @@
 #pragma once
 
 #include "MemoryRegion.h"
+#include "HandleTable.h"
 #include "dot/Node.h"
-#include "utils/ObjectTracker.h"
 #ifdef CWDEBUG
 #include "utils/has_print_on.h"
 #endif
@@ -12,17 +12,23 @@ namespace cppgraphviz {
 using utils::has_print_on::operator<<;
 #endif
 
-class MemoryRegionOwner;
-using MemoryRegionOwnerTracker = utils::ObjectTracker<MemoryRegionOwner>;
-
-class MemoryRegionOwner : public utils::TrackedObject<MemoryRegionOwnerTracker>
+// The identity of a MemoryRegionOwner is its handle (see HandleTable), which follows the object when it is moved.
+class MemoryRegionOwner
 {
+ public:
+  using handle_table_type = HandleTable<MemoryRegionOwner>;
+  using handle_type = handle_table_type::Handle;
+
  protected:
   MemoryRegion registered_memory_region_;
+  // The identity of this owner in the memory region linker. Follows the object when it is moved.
+  handle_type handle_;
+  // The kind of owner; the default is used by Vector, whose memory regions are registered by its TrackingAllocator.
+  MemoryRegionSource source_ = MemoryRegionSource::TrackingAllocator;
 
  protected:
-  MemoryRegionOwner() = default;
-  MemoryRegionOwner(MemoryRegion memory_region);
+  MemoryRegionOwner();
+  MemoryRegionOwner(MemoryRegion memory_region, MemoryRegionSource source);
   MemoryRegionOwner(MemoryRegionOwner&& orig, MemoryRegion memory_region);
   ~MemoryRegionOwner();
 
@@ -30,7 +36,13 @@ class MemoryRegionOwner : public utils::TrackedObject<MemoryRegionOwnerTracker>
   virtual void on_memory_region_usage(MemoryRegion const& owner_memory_region, MemoryRegion const& used, dot::NodePtr* node_ptr_ptr) = 0;
 
   void register_new_memory_region(MemoryRegion memory_region);
-  static void unregister_memory_region(MemoryRegion memory_region);
+  static void unregister_memory_region(MemoryRegion memory_region, MemoryRegionSource source);
+
+  // The table that maps the handles of all MemoryRegionOwner objects to the objects.
+  static handle_table_type& handle_table();
+
+  // Accessor.
+  handle_type handle() const { return handle_; }
 
 #ifdef CWDEBUG
  public:
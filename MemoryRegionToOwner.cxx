@@ -0,0 +1,29 @@
+#include "sys.h"
+#include "MemoryRegionToOwner.h"
+#ifdef CWDEBUG
+#include "debug_ostream_operators.h"
+#endif
+
+namespace cppgraphviz {
+
+bool MemoryRegionToOwner::inform_owner(MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr_ptr) const
+{
+  // Note that this relies on the owner not being destructed by another thread while an Item is being
+  // constructed in one of its memory regions. Normally an owner unregisters its memory regions (which
+  // requires the write-lock on the linker that our caller holds a read-lock of) before it releases its handle.
+  MemoryRegionOwner* memory_region_owner = MemoryRegionOwner::handle_table().get(memory_region_owner_handle_);
+  if (!memory_region_owner)
+    return false;
+
+  memory_region_owner->on_memory_region_usage(memory_region_, item_memory_region, node_ptr_ptr);
+  return true;
+}
+
+#ifdef CWDEBUG
+void MemoryRegionToOwner::print_on(std::ostream& os) const
+{
+  os << memory_region_ << " : " << memory_region_owner_handle_;
+}
+#endif
+
+} // namespace cppgraphviz
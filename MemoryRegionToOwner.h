@@ -0,0 +1,59 @@
+#pragma once
+
+#include "MemoryRegionOwner.h"
+#include "dot/Node.h"
+#ifdef CWDEBUG
+#include "utils/has_print_on.h"
+#endif
+
+namespace cppgraphviz {
+#ifdef CWDEBUG
+using utils::has_print_on::operator<<;
+#endif
+
+class MemoryRegionToOwnerLinker;
+class FlatMemoryRegionToOwnerLinker;
+
+class MemoryRegionToOwner
+{
+ private:
+  MemoryRegion memory_region_;
+  MemoryRegionOwner::handle_type memory_region_owner_handle_;
+
+ private:
+  friend class MemoryRegionToOwnerLinker;
+  // Use to construct a key for MemoryRegionToOwnerLinker::memory_region_to_owner_map_.
+  MemoryRegionToOwner(MemoryRegion const& memory_region) : memory_region_(memory_region) { }
+  friend bool operator<(MemoryRegionToOwner const& lhs, MemoryRegionToOwner const& rhs) { return lhs.memory_region_ < rhs.memory_region_; }
+
+ public:
+  MemoryRegionToOwner(MemoryRegion const& memory_region, MemoryRegionOwner::handle_type memory_region_owner_handle) :
+    memory_region_(memory_region), memory_region_owner_handle_(memory_region_owner_handle) { }
+
+  // Used by MemoryRegionToOwnerLinkerSingleton to cache the result of a lookup.
+  MemoryRegionToOwner(MemoryRegionToOwner const& other) = default;
+
+  MemoryRegionToOwner(MemoryRegionToOwner&& other) :
+    memory_region_(other.memory_region_), memory_region_owner_handle_(other.memory_region_owner_handle_) { }
+
+  // Used by FlatMemoryRegionToOwnerLinker to shift its elements; that only happens while
+  // holding the write-lock on the linker, so the required external synchronization is there.
+  MemoryRegionToOwner& operator=(MemoryRegionToOwner&& other)
+  {
+    memory_region_.critical_area_assign(other.memory_region_);
+    memory_region_owner_handle_ = other.memory_region_owner_handle_;
+    return *this;
+  }
+
+  // Call on_memory_region_usage of the owner, if it still exists. Returns true if it did.
+  bool inform_owner(MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr) const;
+
+  // Accessor.
+  MemoryRegion const& memory_region() const { return memory_region_; }
+
+#ifdef CWDEBUG
+  void print_on(std::ostream& os) const;
+#endif
+};
+
+} // namespace cppgraphviz
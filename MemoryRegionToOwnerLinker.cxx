@@ -2,6 +2,9 @@
 #include "MemoryRegionToOwnerLinker.h"
 #include "Node.h"
 #include <exception>
+#include <limits>
+#include <algorithm>
+#include <optional>
 #ifdef CWDEBUG
 #include "utils/has_print_on.h"
 #include "debug_ostream_operators.h"
@@ -9,42 +12,6 @@
 
 namespace cppgraphviz {
 
-std::weak_ptr<MemoryRegionOwnerTracker> const& MemoryRegionToOwner::get_memory_region_owner_tracker(
-    MemoryRegion const& memory_region_key, std::weak_ptr<MemoryRegionOwnerTracker> const& default_memory_region_owner_tracker) const
-{
-  DoutEntering(dc::notice, "MemoryRegionToOwner::get_memory_region_owner_tracker(" <<
-      memory_region_key << ", " << default_memory_region_owner_tracker << ")");
-
-  if (memory_region_key.lays_within(memory_region_))
-  {
-    Dout(dc::notice, memory_region_key << " lays within " << memory_region_ << ": returning " << memory_region_owner_tracker_);
-    return memory_region_owner_tracker_;
-  }
-
-  // It should not be possible that a memory region is being constructed that only partially falls within the current memory area.
-  ASSERT(!memory_region_key.overlaps_with(memory_region_));
-
-  Dout(dc::notice, memory_region_key << " does not lay within " << memory_region_ << ": returning " << default_memory_region_owner_tracker);
-  return default_memory_region_owner_tracker;
-}
-
-bool MemoryRegionToOwner::inform_owner(MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr_ptr) const
-{
-  auto memory_region_owner_tracker = memory_region_owner_tracker_.lock();
-  if (!memory_region_owner_tracker)
-    return false;
-
-  memory_region_owner_tracker->tracked_object().on_memory_region_usage(memory_region_, item_memory_region, node_ptr_ptr);
-  return true;
-}
-
-#ifdef CWDEBUG
-void MemoryRegionToOwner::print_on(std::ostream& os) const
-{
-  os << memory_region_ << " : " << memory_region_owner_tracker_;
-}
-#endif
-
 bool MemoryRegionToOwnerLinker::erase_memory_region_to_owner(MemoryRegion const& memory_region)
 {
   DoutEntering(dc::notice, "erase_memory_region_to_owner(" << memory_region << ")");
@@ -78,7 +45,8 @@ bool MemoryRegionToOwnerLinker::erase_memory_region_to_owner(MemoryRegion const&
   return true;
 }
 
-bool MemoryRegionToOwnerLinker::inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr) const
+MemoryRegionToOwner const* MemoryRegionToOwnerLinker::inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr,
+    MemoryRegion* cacheable_region, int* depth) const
 {
   DoutEntering(dc::notice, "MemoryRegionToOwnerLinker::inform_owner_of(" << item << ", " << node_ptr_ptr << ")");
 
@@ -89,40 +57,71 @@ bool MemoryRegionToOwnerLinker::inform_owner_of(Item* item, dot::NodePtr* node_p
   // in that case we don't add item to any graph until they are moved (or copied) into
   // a memory region that belongs to a managed Class or Array, later on.
   if (iter == memory_region_to_owner_map_.end())
-    return false;
+    return nullptr;
 
-  return iter->second.inform_owner_of(iter->first, item_memory_region, node_ptr_ptr);
+  if (depth)
+    ++*depth;
+  return iter->second.inform_owner_of(iter->first, item_memory_region, node_ptr_ptr, cacheable_region, depth);
 }
 
-bool MemoryRegionToOwnerLinker::inform_owner_of(
-    MemoryRegionToOwner const& default_owner, MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr_ptr) const
+MemoryRegionToOwner const* MemoryRegionToOwnerLinker::inform_owner_of(MemoryRegionToOwner const& default_owner,
+    MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr_ptr, MemoryRegion* cacheable_region, int* depth) const
 {
   DoutEntering(dc::notice,
       "MemoryRegionToOwnerLinker::inform_owner_of(" << default_owner << ", " << item_memory_region << ", " << node_ptr_ptr << ")");
 
   auto iter = memory_region_to_owner_map_.find(item_memory_region);
 
-  if (iter == memory_region_to_owner_map_.end() ||
-      !iter->second.inform_owner_of(iter->first, item_memory_region, node_ptr_ptr))
+  if (iter != memory_region_to_owner_map_.end())
   {
-    Dout(dc::notice, "not found; using: " << default_owner);
-    return default_owner.inform_owner(item_memory_region, node_ptr_ptr);
+    if (depth)
+      ++*depth;
+    MemoryRegionToOwner const* informed_owner =
+      iter->second.inform_owner_of(iter->first, item_memory_region, node_ptr_ptr, cacheable_region, depth);
+    if (informed_owner)
+      return informed_owner;
+    // default_owner is not the owner of the innermost region; don't let the caller cache it.
+    cacheable_region = nullptr;
   }
 
-  return true;
+  Dout(dc::notice, "not found; using: " << default_owner);
+  if (!default_owner.inform_owner(item_memory_region, node_ptr_ptr))
+    return nullptr;
+
+  if (cacheable_region)
+  {
+    // Every Item that falls between the regions of this level that surround item_memory_region
+    // (these are the regions directly inside the region of default_owner) has the same owner.
+    // Note that upper_bound returns the first region that begins at or after the end of item_memory_region.
+    auto next = memory_region_to_owner_map_.upper_bound(item_memory_region);
+    MemoryRegion const& owner_memory_region = default_owner.memory_region();
+    char const* begin = next == memory_region_to_owner_map_.begin() ?
+      owner_memory_region.begin() : std::prev(next)->first.memory_region().end();
+    char const* end = next == memory_region_to_owner_map_.end() ?
+      owner_memory_region.end() : next->first.memory_region().begin();
+    cacheable_region->critical_area_assign({const_cast<char*>(begin), static_cast<size_t>(end - begin)});
+  }
+
+  return &default_owner;
 }
 
-void MemoryRegionToOwnerLinker::register_new_memory_region_for(MemoryRegion memory_region, std::weak_ptr<MemoryRegionOwnerTracker> const& owner)
+bool MemoryRegionToOwnerLinker::register_new_memory_region_for(MemoryRegion memory_region, MemoryRegionOwner::handle_type owner)
 {
   DoutEntering(dc::notice, "register_new_memory_region_for(" << memory_region << ", " << owner << ")");
 
   // MemoryRegionToOwner, MemoryRegionToOwnerLinker
   MemoryRegionToOwner memory_region_to_owner(memory_region, owner);
   auto ibp = memory_region_to_owner_map_.try_emplace(std::move(memory_region_to_owner));
+  bool nested = false;
   while (!ibp.second)
+  {
+    nested = true;
     ibp = ibp.first->second.memory_region_to_owner_map_.try_emplace(std::move(memory_region_to_owner));
+  }
 
   Dout(dc::notice, "after:\n" << *this);
+
+  return nested;
 }
 
 void MemoryRegionToOwnerLinker::unregister_memory_region(MemoryRegion memory_region)
@@ -153,6 +152,222 @@ void MemoryRegionToOwnerLinker::print_on_with_indentation(std::ostream& os, std:
 }
 #endif
 
+// The result of the last successful lookup of a thread.
+struct MemoryRegionToOwnerLinkerSingleton::LastHit
+{
+  // The cached result is only valid for lookups in shard_ while this equals shard_->generation_.
+  Shard const* shard_ = nullptr;
+  uint64_t generation_ = std::numeric_limits<uint64_t>::max();
+  // Every Item that lays within this region has memory_region_to_owner_ as innermost owner.
+  MemoryRegion cacheable_region_;
+  std::optional<MemoryRegionToOwner> memory_region_to_owner_;
+
+  // Statistics that were not yet added to the totals of the singleton.
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+  static constexpr size_t flush_interval = 1024;
+
+  void flush()
+  {
+    MemoryRegionToOwnerLinkerSingleton& singleton = MemoryRegionToOwnerLinkerSingleton::instance();
+    singleton.cache_hits_.fetch_add(hits_, std::memory_order_relaxed);
+    singleton.cache_misses_.fetch_add(misses_, std::memory_order_relaxed);
+    hits_ = misses_ = 0;
+  }
+
+  void count(bool hit)
+  {
+    if (hit)
+      ++hits_;
+    else
+      ++misses_;
+    if (hits_ + misses_ == flush_interval)
+      flush();
+  }
+
+  ~LastHit()
+  {
+    flush();
+  }
+};
+
+//static
+thread_local MemoryRegionToOwnerLinkerSingleton::LastHit MemoryRegionToOwnerLinkerSingleton::s_last_hit;
+
+MemoryRegionToOwnerLinkerSingleton::MemoryRegionToOwnerLinkerSingleton()
+{
+#ifdef CPPGRAPHVIZ_USE_PAGEMAP_LINKER
+  // Let the page map of each shard only map the pages of the units that the shard handles.
+  for (size_t shard = 0; shard < number_of_shards; ++shard)
+    linker_type::wat(shards_[shard].linker_)->set_shard(shard, number_of_shards, shard_unit_shift);
+#endif
+}
+
+//static
+template<typename FUNC>
+void MemoryRegionToOwnerLinkerSingleton::for_each_bucket_of(MemoryRegion const& memory_region,
+    int unit_shift, size_t number_of_buckets, FUNC func)
+{
+  uintptr_t const first_unit = reinterpret_cast<uintptr_t>(memory_region.begin()) >> unit_shift;
+  uintptr_t const last_unit = reinterpret_cast<uintptr_t>(memory_region.end() - 1) >> unit_shift;
+  // Once number_of_buckets units are visited, all buckets were visited.
+  uintptr_t const end_unit = first_unit + std::min(last_unit - first_unit + 1, static_cast<uintptr_t>(number_of_buckets));
+  for (uintptr_t unit = first_unit; unit != end_unit; ++unit)
+    func(unit % number_of_buckets);
+}
+
+template<typename FUNC>
+void MemoryRegionToOwnerLinkerSingleton::for_each_shard_of(MemoryRegion const& memory_region, FUNC func)
+{
+  for_each_bucket_of(memory_region, shard_unit_shift, number_of_shards, [&](size_t shard){ func(shards_[shard]); });
+}
+
+void MemoryRegionToOwnerLinkerSingleton::add_to_filter(MemoryRegion const& memory_region)
+{
+  // Nothing can be constructed inside an empty region.
+  if (memory_region.begin() == memory_region.end())
+    return;
+
+  // The bounds are never shrunk again: the filter buckets do the fine grained work.
+  uintptr_t const begin = reinterpret_cast<uintptr_t>(memory_region.begin());
+  uintptr_t const end = reinterpret_cast<uintptr_t>(memory_region.end());
+  uintptr_t lowest_begin = filter_lowest_begin_.load(std::memory_order_relaxed);
+  while (begin < lowest_begin && !filter_lowest_begin_.compare_exchange_weak(lowest_begin, begin, std::memory_order_release))
+    ;
+  uintptr_t highest_end = filter_highest_end_.load(std::memory_order_relaxed);
+  while (end > highest_end && !filter_highest_end_.compare_exchange_weak(highest_end, end, std::memory_order_release))
+    ;
+
+  for_each_bucket_of(memory_region, filter_granule_shift, number_of_filter_buckets, [this](size_t bucket){
+    filter_buckets_[bucket].fetch_add(1, std::memory_order_release);
+  });
+}
+
+void MemoryRegionToOwnerLinkerSingleton::remove_from_filter(MemoryRegion const& memory_region)
+{
+  if (memory_region.begin() == memory_region.end())
+    return;
+
+  // Note that every registered memory region is unregistered exactly once by its owner,
+  // also when the linker itself already removed it together with a region that contained it.
+  for_each_bucket_of(memory_region, filter_granule_shift, number_of_filter_buckets, [this](size_t bucket){
+#if CW_DEBUG
+    uint32_t count =
+#endif
+      filter_buckets_[bucket].fetch_sub(1, std::memory_order_relaxed);
+    // Unregistering a memory region that was never registered?
+    ASSERT(count > 0);
+  });
+}
+
+bool MemoryRegionToOwnerLinkerSingleton::might_be_registered(MemoryRegion const& item_memory_region) const
+{
+  uintptr_t const begin = reinterpret_cast<uintptr_t>(item_memory_region.begin());
+  if (begin < filter_lowest_begin_.load(std::memory_order_acquire) ||
+      reinterpret_cast<uintptr_t>(item_memory_region.end()) > filter_highest_end_.load(std::memory_order_acquire))
+    return false;
+  // Any region that contains item_memory_region touches the granule that it begins in.
+  return filter_buckets_[(begin >> filter_granule_shift) % number_of_filter_buckets].load(std::memory_order_acquire) > 0;
+}
+
+bool MemoryRegionToOwnerLinkerSingleton::inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr)
+{
+  MemoryRegion item_memory_region(reinterpret_cast<char*>(item), sizeof(Item));
+  Shard& shard = shards_[unit_of(item_memory_region.begin()) % number_of_shards];
+
+  if (!might_be_registered(item_memory_region))
+  {
+    shard.statistics_.lookup(0, false);
+    shard.statistics_.filtered();
+    return false;
+  }
+
+  LastHit& last_hit = s_last_hit;
+
+  // Take the read-lock on the linker of this shard.
+  auto lock_wait_start = shard.statistics_.start_lock_wait();
+  linker_type::rat linker_r(shard.linker_);
+  shard.statistics_.end_lock_wait(lock_wait_start);
+
+  if (last_hit.shard_ == &shard &&
+      last_hit.generation_ == shard.generation_.load(std::memory_order_relaxed) &&
+      item_memory_region.lays_within(last_hit.cacheable_region_) &&
+      last_hit.memory_region_to_owner_->inform_owner(item_memory_region, node_ptr_ptr))
+  {
+    Dout(dc::notice, "MemoryRegionToOwnerLinkerSingleton::inform_owner_of(" << item << ", " << node_ptr_ptr << "): cache hit.");
+    last_hit.count(true);
+    shard.statistics_.lookup(1, true);
+    return true;
+  }
+  last_hit.count(false);
+
+  MemoryRegion cacheable_region;
+  int depth = 0;
+  MemoryRegionToOwner const* informed_owner = linker_r->inform_owner_of(item, node_ptr_ptr, &cacheable_region, &depth);
+  shard.statistics_.lookup(depth, informed_owner != nullptr);
+  if (cacheable_region.begin())
+  {
+    last_hit.shard_ = &shard;
+    last_hit.generation_ = shard.generation_.load(std::memory_order_relaxed);
+    last_hit.cacheable_region_.critical_area_assign(cacheable_region);
+    last_hit.memory_region_to_owner_.emplace(*informed_owner);
+  }
+  return informed_owner != nullptr;
+}
+
+void MemoryRegionToOwnerLinkerSingleton::register_new_memory_region_for(MemoryRegion memory_region,
+    MemoryRegionOwner::handle_type owner, MemoryRegionSource source)
+{
+  shards_[unit_of(memory_region.begin()) % number_of_shards].statistics_.registered(source);
+
+  // The shards are locked one at a time; the region only needs to be visible in all of
+  // them once this function returns (before any Item is constructed inside it).
+  add_to_filter(memory_region);
+  for_each_shard_of(memory_region, [&](Shard& shard){
+    auto lock_wait_start = shard.statistics_.start_lock_wait();
+    linker_type::wat linker_w(shard.linker_);
+    shard.statistics_.end_lock_wait(lock_wait_start);
+    // A region that is registered inside another region can make the cached innermost region of a thread no longer the innermost.
+    if (linker_w->register_new_memory_region_for(memory_region, owner))
+      shard.generation_.fetch_add(1, std::memory_order_relaxed);
+  });
+}
+
+void MemoryRegionToOwnerLinkerSingleton::unregister_memory_region(MemoryRegion memory_region, MemoryRegionSource source)
+{
+  shards_[unit_of(memory_region.begin()) % number_of_shards].statistics_.unregistered(source);
+  for_each_shard_of(memory_region, [&](Shard& shard){
+    auto lock_wait_start = shard.statistics_.start_lock_wait();
+    linker_type::wat linker_w(shard.linker_);
+    shard.statistics_.end_lock_wait(lock_wait_start);
+    linker_w->unregister_memory_region(memory_region);
+    shard.generation_.fetch_add(1, std::memory_order_relaxed);
+  });
+  remove_from_filter(memory_region);
+}
+
+#ifdef CPPGRAPHVIZ_LINKER_STATISTICS
+MemoryRegionToOwnerLinkerStatistics::Snapshot MemoryRegionToOwnerLinkerSingleton::statistics() const
+{
+  MemoryRegionToOwnerLinkerStatistics::Snapshot snapshot;
+  snapshot.time_ = MemoryRegionToOwnerLinkerStatistics::clock_type::now();
+  for (Shard const& shard : shards_)
+    shard.statistics_.add_to(snapshot);
+  return snapshot;
+}
+#endif
+
+#ifdef CPPGRAPHVIZ_USE_PAGEMAP_LINKER
+size_t MemoryRegionToOwnerLinkerSingleton::page_map_memory_overhead() const
+{
+  size_t memory_overhead = 0;
+  for (Shard const& shard : shards_)
+    memory_overhead += linker_type::crat(shard.linker_)->memory_overhead();
+  return memory_overhead;
+}
+#endif
+
 } // namespace cppgraphviz
 
 // Instantiate the singleton.
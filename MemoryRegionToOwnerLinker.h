@@ -1,50 +1,22 @@
 #pragma once
 
-#include "MemoryRegionOwner.h"
+#include "MemoryRegionToOwner.h"
+#include "FlatMemoryRegionToOwnerLinker.h"
+#include "PageMapMemoryRegionToOwnerLinker.h"
+#include "MemoryRegionToOwnerLinkerStatistics.h"
 #include "dot/Node.h"
 #include "utils/Singleton.h"
 #include "threadsafe/threadsafe.h"
+#include "threadsafe/AIReadWriteMutex.h"
+#include <atomic>
+#include <array>
+#include <limits>
 
 namespace cppgraphviz {
 using utils::has_print_on::operator<<;
 
-class MemoryRegionToOwnerLinker;
 class Item;
 
-class MemoryRegionToOwner
-{
- private:
-  MemoryRegion memory_region_;
-  std::weak_ptr<MemoryRegionOwnerTracker> memory_region_owner_tracker_;
-
- private:
-  friend class MemoryRegionToOwnerLinker;
-  // Use to construct a key for MemoryRegionToOwnerLinker::memory_region_to_owner_map_.
-  MemoryRegionToOwner(MemoryRegion const& memory_region) : memory_region_(memory_region) { }
-  friend bool operator<(MemoryRegionToOwner const& lhs, MemoryRegionToOwner const& rhs) { return lhs.memory_region_ < rhs.memory_region_; }
-
- public:
-  MemoryRegionToOwner(MemoryRegion const& memory_region, std::weak_ptr<MemoryRegionOwnerTracker> const& memory_region_owner_tracker) :
-    memory_region_(memory_region), memory_region_owner_tracker_(memory_region_owner_tracker) { }
-
-  MemoryRegionToOwner(MemoryRegionToOwner&& other) :
-    memory_region_(other.memory_region_), memory_region_owner_tracker_(std::move(other.memory_region_owner_tracker_)) { }
-
-  // Return memory_region_owner_tracker_ if [item, item + size> falls inside memory_region_,
-  // otherwise return default_memory_region_owner_tracker.
-  std::weak_ptr<MemoryRegionOwnerTracker> const& get_memory_region_owner_tracker(
-      MemoryRegion const& memory_region_key, std::weak_ptr<MemoryRegionOwnerTracker> const& default_memory_region_owner_tracker) const;
-
-  bool inform_owner(MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr) const;
-
-  // Accessor.
-  MemoryRegion const& memory_region() const { return memory_region_; }
-
-#ifdef CWDEBUG
-  void print_on(std::ostream& os) const;
-#endif
-};
-
 // MemoryRegion's can be inside one another, but they can not
 // partially overlap.
 //
@@ -78,12 +50,23 @@ class MemoryRegionToOwnerLinker
   bool erase_memory_region_to_owner(MemoryRegion const& memory_region);
 
   // Called by the public inform_owner_of.
-  bool inform_owner_of(MemoryRegionToOwner const& default_owner, MemoryRegion const& item_memory_region, dot::NodePtr* node_ptr) const;
+  MemoryRegionToOwner const* inform_owner_of(MemoryRegionToOwner const& default_owner, MemoryRegion const& item_memory_region,
+      dot::NodePtr* node_ptr, MemoryRegion* cacheable_region, int* depth) const;
 
  public:
-  bool inform_owner_of(Item* item, dot::NodePtr* node_ptr = nullptr) const;
-
-  void register_new_memory_region_for(MemoryRegion memory_region, std::weak_ptr<MemoryRegionOwnerTracker> const& owner);
+  // Inform the owner of the innermost memory region that contains item, falling back to the owners of
+  // the regions that contain that region if that owner was already destructed.
+  // Returns the MemoryRegionToOwner whose owner was informed, or nullptr if there was none.
+  //
+  // If cacheable_region is not null and the informed owner is the owner of the innermost region,
+  // then *cacheable_region is set to a region around item in which every Item has that same owner.
+  //
+  // If depth is not null, *depth is incremented for every memory region that was looked at.
+  MemoryRegionToOwner const* inform_owner_of(Item* item, dot::NodePtr* node_ptr = nullptr, MemoryRegion* cacheable_region = nullptr,
+      int* depth = nullptr) const;
+
+  // Returns true if memory_region was registered inside another memory region.
+  bool register_new_memory_region_for(MemoryRegion memory_region, MemoryRegionOwner::handle_type owner);
   void unregister_memory_region(MemoryRegion memory_region);
 
   bool empty() const { return memory_region_to_owner_map_.empty(); }
@@ -98,13 +81,124 @@ class MemoryRegionToOwnerLinkerSingleton : public Singleton<MemoryRegionToOwnerL
 {
   friend_Instance;
  private:
-  MemoryRegionToOwnerLinkerSingleton() = default;
+  MemoryRegionToOwnerLinkerSingleton();
   ~MemoryRegionToOwnerLinkerSingleton() = default;
   MemoryRegionToOwnerLinkerSingleton(MemoryRegionToOwnerLinkerSingleton const&) = delete;
 
  public:
-  using linker_type = threadsafe::Unlocked<MemoryRegionToOwnerLinker, threadsafe::policy::Primitive<std::mutex>>;
-  linker_type linker_;
+#ifdef CPPGRAPHVIZ_USE_FLAT_LINKER
+  using linker_backend_type = FlatMemoryRegionToOwnerLinker;
+#elif defined(CPPGRAPHVIZ_USE_PAGEMAP_LINKER)
+  using linker_backend_type = PageMapMemoryRegionToOwnerLinker;
+#else
+  using linker_backend_type = MemoryRegionToOwnerLinker;
+#endif
+  // Looking up the owner of an Item (Item constructors take a read-lock) is far more common than
+  // registering or unregistering a memory region (which takes the write-lock), so use a read/write
+  // lock that allows lookups from different threads to run concurrently.
+  //
+  // Note that this means that MemoryRegionOwner::on_memory_region_usage can be called concurrently
+  // by different threads, for different owners only: on_memory_region_usage modifies the state of
+  // the owner without locking it, therefore the elements of the same container (and the members
+  // of the same class) must not be constructed by more than one thread at a time.
+  using linker_type = threadsafe::Unlocked<linker_backend_type, threadsafe::policy::ReadWrite<AIReadWriteMutex>>;
+
+  // In order to avoid that threads that construct objects in unrelated memory (different arenas,
+  // different thread stacks) contend on a single lock, the linker is split into shards that each
+  // have their own lock. The address space is divided into units of 2^shard_unit_shift bytes and
+  // unit u is handled by shard u % number_of_shards.
+  //
+  // A memory region that straddles the boundary of a unit is registered in every shard that
+  // handles one of the units that it touches (which is all shards if it touches number_of_shards
+  // units or more). Since every shard then contains all regions that overlap with its units,
+  // looking up an Item only needs the shard of the unit that the Item begins in.
+  // A PageMapMemoryRegionToOwnerLinker only maps the pages of the units of its own shard.
+  static constexpr int shard_unit_shift = 20;           // 1 MiB.
+  static constexpr size_t number_of_shards = 64;
+
+  // Aligned to avoid false sharing between the locks of different shards.
+  struct alignas(64) Shard
+  {
+    linker_type linker_;
+
+    // Incremented, while holding the write-lock on linker_, whenever linker_ is changed in a way
+    // that could invalidate the cached results of lookups: when a region is unregistered, or when
+    // a region is registered inside another region (which then might no longer be the innermost).
+    std::atomic<uint64_t> generation_ = 0;
+
+    // Lookups are counted in the shard that they are done in; (un)registrations in the shard of the first unit of the region.
+    MemoryRegionToOwnerLinkerStatistics statistics_;
+  };
+
+ private:
+  std::array<Shard, number_of_shards> shards_;
+
+  static uintptr_t unit_of(char const* ptr) { return reinterpret_cast<uintptr_t>(ptr) >> shard_unit_shift; }
+
+  // Call func(bucket) for every bucket that contains memory_region, where the address space is divided
+  // into units of 2^unit_shift bytes and unit u is in bucket u % number_of_buckets.
+  template<typename FUNC>
+  static void for_each_bucket_of(MemoryRegion const& memory_region, int unit_shift, size_t number_of_buckets, FUNC func);
+
+  // Call func(shard) for every shard that contains memory_region.
+  template<typename FUNC>
+  void for_each_shard_of(MemoryRegion const& memory_region, FUNC func);
+
+  // Most Item's that are not inside any registered memory region (temporaries, stack locals,
+  // top-level nodes) are rejected by this lock-free filter, before the linker is locked.
+  //
+  // The address space is divided into granules of 2^filter_granule_shift bytes and granule g
+  // is counted in filter bucket g % number_of_filter_buckets. Each bucket holds the number of
+  // registered memory regions that touch one of its granules. Together with the bounds of all
+  // memory regions ever registered (which only grow) this gives false positives, but never
+  // false negatives.
+  static constexpr int filter_granule_shift = 16;       // 64 kiB.
+  static constexpr size_t number_of_filter_buckets = 16384;
+
+  std::array<std::atomic<uint32_t>, number_of_filter_buckets> filter_buckets_{};
+  std::atomic<uintptr_t> filter_lowest_begin_ = std::numeric_limits<uintptr_t>::max();
+  std::atomic<uintptr_t> filter_highest_end_ = 0;
+
+  // Called before memory_region is added to the linker, respectively after it was removed from it.
+  void add_to_filter(MemoryRegion const& memory_region);
+  void remove_from_filter(MemoryRegion const& memory_region);
+
+  // Returns false if item_memory_region can not be inside any registered memory region.
+  bool might_be_registered(MemoryRegion const& item_memory_region) const;
+
+  // Members of a Class and consecutive elements of an Array or Vector are constructed
+  // back to back, and therefore usually have the same owner as the previous lookup
+  // of the same thread. Each thread therefore caches the result of its last lookup.
+  struct LastHit;
+  static thread_local LastHit s_last_hit;
+
+  // Lookup cache statistics. Each thread adds its own counts to these every
+  // LastHit::flush_interval lookups, and when it exits.
+  std::atomic<size_t> cache_hits_ = 0;
+  std::atomic<size_t> cache_misses_ = 0;
+
+ public:
+  // Inform the owner of the innermost registered memory region that contains item, if any.
+  // Returns true if an owner was informed.
+  bool inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr = nullptr);
+
+  void register_new_memory_region_for(MemoryRegion memory_region, MemoryRegionOwner::handle_type owner,
+      MemoryRegionSource source);
+  void unregister_memory_region(MemoryRegion memory_region, MemoryRegionSource source);
+
+  // Accessors for the lookup cache statistics.
+  size_t cache_hits() const { return cache_hits_.load(std::memory_order_relaxed); }
+  size_t cache_misses() const { return cache_misses_.load(std::memory_order_relaxed); }
+
+#ifdef CPPGRAPHVIZ_LINKER_STATISTICS
+  // Return the sum of the statistics of all shards.
+  MemoryRegionToOwnerLinkerStatistics::Snapshot statistics() const;
+#endif
+
+#ifdef CPPGRAPHVIZ_USE_PAGEMAP_LINKER
+  // The total number of bytes used by the page maps of all shards.
+  size_t page_map_memory_overhead() const;
+#endif
 };
 
 } // namespace cppgraphviz
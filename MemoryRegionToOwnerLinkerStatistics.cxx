@@ -0,0 +1,42 @@
+#include "sys.h"
+#include "MemoryRegionToOwnerLinkerStatistics.h"
+
+namespace cppgraphviz {
+
+namespace {
+
+char const* to_string(MemoryRegionSource source)
+{
+  switch (source)
+  {
+    case MemoryRegionSource::Class:
+      return "Class";
+    case MemoryRegionSource::Array:
+      return "Array";
+    case MemoryRegionSource::TrackingAllocator:
+      return "TrackingAllocator";
+  }
+  return "<unknown MemoryRegionSource>";
+}
+
+} // namespace
+
+void MemoryRegionToOwnerLinkerStatistics::Snapshot::print_on(std::ostream& os) const
+{
+  os << "{lookups:" << lookups_ << ", found:" << found_ << ", not found:" << not_found() << " (filtered:" << filtered_ <<
+    "), depth histogram:{";
+  char const* separator = "";
+  for (size_t depth = 0; depth < depth_histogram_size; ++depth)
+  {
+    os << separator << depth << (depth == depth_histogram_size - 1 ? "+:" : ":") << depth_histogram_[depth];
+    separator = ", ";
+  }
+  os << "}, lock wait time:" << std::chrono::duration_cast<std::chrono::microseconds>(lock_wait_time_).count() << " us" <<
+    ", live regions:" << live_regions();
+  for (size_t source = 0; source < number_of_sources; ++source)
+    os << ", " << to_string(static_cast<MemoryRegionSource>(source)) << ":{registered:" << registrations_[source] <<
+      ", unregistered:" << unregistrations_[source] << '}';
+  os << '}';
+}
+
+} // namespace cppgraphviz
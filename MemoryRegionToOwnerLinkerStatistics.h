@@ -0,0 +1,141 @@
+#pragma once
+
+#include "MemoryRegion.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace cppgraphviz {
+
+// Counters that give insight in the cost of finding the owner of an Item.
+//
+// MemoryRegionToOwnerLinkerSingleton has one object of this type per shard, so that
+// threads that work in unrelated memory do not write to the same cache lines.
+// Use MemoryRegionToOwnerLinkerSingleton::statistics() to get a Snapshot of the sum.
+//
+// Unless CPPGRAPHVIZ_LINKER_STATISTICS is defined this is an empty class whose
+// member functions do nothing.
+class MemoryRegionToOwnerLinkerStatistics
+{
+ public:
+  using clock_type = std::chrono::steady_clock;
+
+  static constexpr size_t number_of_sources = 3;                // The number of MemoryRegionSource values.
+  static constexpr size_t depth_histogram_size = 8;             // The last bucket counts all larger depths.
+
+  struct Snapshot
+  {
+    clock_type::time_point time_;                               // The time at which this snapshot was taken.
+    size_t lookups_ = 0;                                        // The number of calls to inform_owner_of.
+    size_t found_ = 0;                                          // The number of those that informed an owner.
+    size_t filtered_ = 0;                                       // The number of lookups rejected by the negative filter.
+    std::array<size_t, depth_histogram_size> depth_histogram_{};// The number of lookups per number of memory regions looked at.
+    clock_type::duration lock_wait_time_{};                     // The total time spent waiting for a linker lock.
+    std::array<size_t, number_of_sources> registrations_{};     // The number of registered memory regions per MemoryRegionSource.
+    std::array<size_t, number_of_sources> unregistrations_{};   // The number of unregistered memory regions per MemoryRegionSource.
+
+    size_t not_found() const { return lookups_ - found_; }
+
+    size_t live_regions() const
+    {
+      size_t live_regions = 0;
+      for (size_t source = 0; source < number_of_sources; ++source)
+        live_regions += registrations_[source] - unregistrations_[source];
+      return live_regions;
+    }
+
+    // The number of lookups per second since the earlier snapshot.
+    double lookups_per_second(Snapshot const& earlier) const
+    {
+      return per_second(lookups_ - earlier.lookups_, earlier);
+    }
+
+    // The number of (un)registered memory regions of source per second since the earlier snapshot.
+    double registrations_per_second(Snapshot const& earlier, MemoryRegionSource source) const
+    {
+      return per_second(registrations_[static_cast<size_t>(source)] - earlier.registrations_[static_cast<size_t>(source)], earlier);
+    }
+
+    double unregistrations_per_second(Snapshot const& earlier, MemoryRegionSource source) const
+    {
+      return per_second(unregistrations_[static_cast<size_t>(source)] - earlier.unregistrations_[static_cast<size_t>(source)], earlier);
+    }
+
+    void print_on(std::ostream& os) const;
+
+   private:
+    double per_second(size_t count, Snapshot const& earlier) const
+    {
+      return count / std::chrono::duration<double>(time_ - earlier.time_).count();
+    }
+  };
+
+#ifdef CPPGRAPHVIZ_LINKER_STATISTICS
+ private:
+  std::atomic<size_t> lookups_ = 0;
+  std::atomic<size_t> found_ = 0;
+  std::atomic<size_t> filtered_ = 0;
+  std::array<std::atomic<size_t>, depth_histogram_size> depth_histogram_{};
+  std::atomic<clock_type::rep> lock_wait_ticks_ = 0;
+  std::array<std::atomic<size_t>, number_of_sources> registrations_{};
+  std::array<std::atomic<size_t>, number_of_sources> unregistrations_{};
+
+ public:
+  // Call start_lock_wait() before locking a linker and pass its result to end_lock_wait() once the lock is obtained.
+  clock_type::time_point start_lock_wait() const { return clock_type::now(); }
+  void end_lock_wait(clock_type::time_point start)
+  {
+    lock_wait_ticks_.fetch_add((clock_type::now() - start).count(), std::memory_order_relaxed);
+  }
+
+  // Called once for every lookup, depth being the number of memory regions that were looked at.
+  void lookup(int depth, bool found)
+  {
+    lookups_.fetch_add(1, std::memory_order_relaxed);
+    if (found)
+      found_.fetch_add(1, std::memory_order_relaxed);
+    depth_histogram_[std::min(static_cast<size_t>(depth), depth_histogram_size - 1)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Called (in addition to lookup) for a lookup that was rejected by the negative filter.
+  void filtered() { filtered_.fetch_add(1, std::memory_order_relaxed); }
+
+  void registered(MemoryRegionSource source)
+  {
+    registrations_[static_cast<size_t>(source)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void unregistered(MemoryRegionSource source)
+  {
+    unregistrations_[static_cast<size_t>(source)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Add the counters of this object to snapshot.
+  void add_to(Snapshot& snapshot) const
+  {
+    snapshot.lookups_ += lookups_.load(std::memory_order_relaxed);
+    snapshot.found_ += found_.load(std::memory_order_relaxed);
+    snapshot.filtered_ += filtered_.load(std::memory_order_relaxed);
+    for (size_t depth = 0; depth < depth_histogram_size; ++depth)
+      snapshot.depth_histogram_[depth] += depth_histogram_[depth].load(std::memory_order_relaxed);
+    snapshot.lock_wait_time_ += clock_type::duration{lock_wait_ticks_.load(std::memory_order_relaxed)};
+    for (size_t source = 0; source < number_of_sources; ++source)
+    {
+      snapshot.registrations_[source] += registrations_[source].load(std::memory_order_relaxed);
+      snapshot.unregistrations_[source] += unregistrations_[source].load(std::memory_order_relaxed);
+    }
+  }
+#else
+ public:
+  clock_type::time_point start_lock_wait() const { return {}; }
+  void end_lock_wait(clock_type::time_point) { }
+  void lookup(int, bool) { }
+  void filtered() { }
+  void registered(MemoryRegionSource) { }
+  void unregistered(MemoryRegionSource) { }
+#endif
+};
+
+} // namespace cppgraphviz
@@ -32,7 +32,7 @@ locked_Node::locked_Node(std::weak_ptr<GraphTracker> const& root_graph, std::str
 locked_Node::locked_Node(locked_Node&& node, std::string_view what) : ItemTemplate<Node, NodeTracker>(std::move(node))
 {
   DoutEntering(dc::notice, "locked_Node(locked_Node&& " << &node << ", \"" << what << "\") [" << this << "]");
-  tracker_->set_what(what);
+  change_what(what);
 }
 
 // Copy a Node, creating a new NodeTracker as well.
@@ -78,6 +78,10 @@ locked_Node::~locked_Node()
 
 void locked_Node::initialize_item()
 {
+  if (!tracker_->attributes_dirty())
+    return;
+  // Clear the flag first, so that a concurrent change marks it dirty again.
+  tracker_->clear_attributes_dirty();
   // Add the attributes of this locked_Node.
   item_attributes(dot::NodePtr::unlocked_type::wat{tracker_->node_ptr().item()}->attribute_list());
 }
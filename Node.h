@@ -1,10 +1,16 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "Item.h"
+#include "ChildSlots.h"
 #include "dot/Node.h"
 #include "threadsafe/ObjectTracker.h"
 #include "utils/has_print_on.h"
 #include <boost/intrusive_ptr.hpp>
+#include <atomic>
 #ifdef CWDEBUG
 #include "debug_ostream_operators.h"
 #endif
@@ -42,6 +48,8 @@ class NodeTracker final : public threadsafe::ObjectTracker<Node, locked_Node, do
 {
  private:
   dot::NodePtr node_ptr_;       // Unique pointer to the corresponding dot::NodeItem.
+  size_t parent_slot_ = ChildSlots<NodeTracker>::no_slot;       // The slot of this tracker in the node_trackers_ of the parent graph; only accessed while that graph is locked.
+  std::atomic<bool> attributes_dirty_ = true;                  // Set when item_attributes must be called (again) before writing the dot file.
 
  public:
   NodeTracker(utils::Badge<threadsafe::TrackedObject<Node, NodeTracker>>, Node& node);
@@ -53,6 +61,16 @@ class NodeTracker final : public threadsafe::ObjectTracker<Node, locked_Node, do
     node_item_w->attribute_list().add({"what", what});
   }
 
+  void set_parent_slot(size_t parent_slot) { parent_slot_ = parent_slot; }
+  size_t parent_slot() const { return parent_slot_; }
+
+  // Mark that item_attributes must be called (again) for the tracked item.
+  void mark_attributes_dirty() { attributes_dirty_.store(true, std::memory_order_relaxed); }
+  // Return true if the tracked item must be initialized; this can be called without locking the tracked item.
+  bool attributes_dirty() const { return attributes_dirty_.load(std::memory_order_relaxed); }
+  // Called by initialize_item before calling item_attributes.
+  void clear_attributes_dirty() { attributes_dirty_.store(false, std::memory_order_relaxed); }
+
   dot::NodePtr const& node_ptr() const { return node_ptr_; }
   dot::NodePtr& node_ptr() { return node_ptr_; }
 };
@@ -86,3 +104,5 @@ class locked_Node : public ItemTemplate<Node, NodeTracker>
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
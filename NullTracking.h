@@ -0,0 +1,134 @@
+#pragma once
+
+// This header is included instead of the normal definitions of Graph, Node, LabelNode,
+// RectangleNode, Class, Array and Vector when CPPGRAPHVIZ_DISABLE_TRACKING is defined.
+//
+// The types below have the same constructors as the real ones, so that code using them
+// compiles unchanged, but they track nothing: there are no memory regions, no trackers
+// and no dot items. Array and Vector are plain utils::Array and utils::Vector; the latter
+// uses the default allocator, unless std::pmr::polymorphic_allocator<T> was passed as its
+// allocator in order to pass an upstream memory resource.
+//
+// Graph and Node keep a virtual item_attributes, so that classes derived from them can
+// still override it; that costs one vtable pointer per object and is never called.
+
+#include "dot/AttributeList.h"
+#include "utils/Array.h"
+#include "utils/Vector.h"
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace cppgraphviz {
+
+class GraphTracker;
+class NodeTracker;
+
+class Graph
+{
+ public:
+  Graph(std::string_view UNUSED_ARG(what)) { }
+  Graph(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::string_view UNUSED_ARG(what)) { }
+  Graph(Graph&& UNUSED_ARG(orig), std::string_view UNUSED_ARG(what)) { }
+
+  // Copying a Graph is not allowed.
+  Graph(Graph const& other) = delete;
+
+  virtual ~Graph() = default;
+
+  // There is no GraphTracker; this is what is passed as root graph.
+  operator std::weak_ptr<GraphTracker>() const { return {}; }
+
+  void write_dot(std::ostream& os) const
+  {
+    os << "digraph {\n}\n";
+  }
+
+ protected:
+  // Used by Class.
+  Graph(Graph const& UNUSED_ARG(other), std::string_view UNUSED_ARG(what)) { }
+
+  virtual void item_attributes(dot::AttributeList& UNUSED_ARG(list)) { }
+  void mark_attributes_dirty() { }
+};
+
+class Node
+{
+ public:
+  Node(std::string_view UNUSED_ARG(what)) { }
+  Node(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::string_view UNUSED_ARG(what)) { }
+  Node(Node&& UNUSED_ARG(node), std::string_view UNUSED_ARG(what)) { }
+  Node(Node const& UNUSED_ARG(other), std::string_view UNUSED_ARG(what)) { }
+  Node(Node const& other) = default;
+  Node(Node&& node) = default;
+
+  virtual ~Node() = default;
+
+  operator std::weak_ptr<NodeTracker>() const { return {}; }
+
+ protected:
+  virtual void item_attributes(dot::AttributeList& UNUSED_ARG(list)) { }
+  void mark_attributes_dirty() { }
+};
+
+class LabelNode : public Node
+{
+ public:
+  using Node::Node;
+
+  void set_label(std::string const& UNUSED_ARG(label)) { }
+};
+
+struct RectangleNode : LabelNode
+{
+  using LabelNode::LabelNode;
+};
+
+template<typename T>
+class Class : public Graph
+{
+ public:
+  template<typename WP>
+  requires std::is_convertible_v<WP, std::weak_ptr<GraphTracker> const&>
+  Class(WP const& UNUSED_ARG(root_graph), std::string_view what) : Graph(what) { }
+  Class(Class const& other, std::string_view what) : Graph(other, what) { }
+  Class(Class&& other, std::string_view what) : Graph(std::move(other), what) { }
+
+  void set_label(std::string const& UNUSED_ARG(label)) { }
+};
+
+template<typename T, size_t N, typename _Index = utils::ArrayIndex<T>>
+class Array : public utils::Array<T, N, _Index>
+{
+ public:
+  constexpr Array(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::initializer_list<T> ilist, std::string_view UNUSED_ARG(what)) :
+    utils::Array<T, N, _Index>(ilist) { }
+  Array(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::string_view UNUSED_ARG(what)) { }
+  Array(Array const& other, std::string_view UNUSED_ARG(what)) : utils::Array<T, N, _Index>(other) { }
+  Array(Array&& other, std::string_view UNUSED_ARG(what)) : utils::Array<T, N, _Index>(std::move(other)) { }
+};
+
+template <typename T, typename _Index = utils::VectorIndex<T>, typename _Alloc = std::allocator<T>>
+class Vector : public utils::Vector<T, _Index, _Alloc>
+{
+ public:
+  using _Base = utils::Vector<T, _Index, _Alloc>;
+  static constexpr bool has_upstream = std::is_same_v<_Alloc, std::pmr::polymorphic_allocator<T>>;
+
+  Vector(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::initializer_list<T> ilist, std::string_view UNUSED_ARG(what)) :
+    _Base(ilist) { }
+  Vector(std::weak_ptr<GraphTracker> const& UNUSED_ARG(root_graph), std::initializer_list<T> ilist, std::string_view UNUSED_ARG(what),
+      std::pmr::memory_resource* upstream) requires has_upstream :
+    _Base(ilist, upstream) { }
+  // Copying a std::pmr container would use the default memory resource; keep using that of other.
+  Vector(Vector const& other, std::string_view UNUSED_ARG(what)) : _Base(other, other.get_allocator()) { }
+  Vector(Vector&& other, std::string_view UNUSED_ARG(what)) : _Base(std::move(other)) { }
+
+  std::pmr::memory_resource* upstream_resource() const requires has_upstream { return this->get_allocator().resource(); }
+};
+
+} // namespace cppgraphviz
@@ -0,0 +1,236 @@
+#include "sys.h"
+#include "PageMapMemoryRegionToOwnerLinker.h"
+#include "Item.h"
+#include <algorithm>
+#ifdef CWDEBUG
+#include "debug_ostream_operators.h"
+#endif
+
+namespace cppgraphviz {
+
+namespace {
+
+using PageMap = PageMapMemoryRegionToOwnerLinker;
+
+// Return the index into the node at `level` (0 being the root) of the path to `page`.
+size_t index_at(uintptr_t page, int level)
+{
+  return (page >> ((PageMap::number_of_levels - 1 - level) * PageMap::bits_per_level)) & (PageMap::fanout - 1);
+}
+
+template<typename Child>
+Child& get_or_create(std::unique_ptr<Child>& child, size_t& nodes_memory)
+{
+  if (!child)
+  {
+    child = std::make_unique<Child>();
+    nodes_memory += sizeof(Child);
+  }
+  return *child;
+}
+
+} // namespace
+
+PageMapMemoryRegionToOwnerLinker::page_list_type const* PageMapMemoryRegionToOwnerLinker::find_page_list(uintptr_t page) const
+{
+  // No region can be registered beyond the supported address space (see register_new_memory_region_for).
+  if (!in_range(page))
+    return nullptr;
+
+  level1_type const* level1 = root_.children_[index_at(page, 0)].get();
+  if (!level1)
+    return nullptr;
+  level2_type const* level2 = level1->children_[index_at(page, 1)].get();
+  if (!level2)
+    return nullptr;
+  Leaf const* leaf = level2->children_[index_at(page, 2)].get();
+  if (!leaf)
+    return nullptr;
+  return &leaf->page_lists_[index_at(page, 3)];
+}
+
+PageMapMemoryRegionToOwnerLinker::page_list_type& PageMapMemoryRegionToOwnerLinker::get_page_list(uintptr_t page)
+{
+  // Only 48 bits of address space are supported.
+  ASSERT(in_range(page));
+
+  level1_type& level1 = get_or_create(root_.children_[index_at(page, 0)], nodes_memory_);
+  level2_type& level2 = get_or_create(level1.children_[index_at(page, 1)], nodes_memory_);
+  Leaf& leaf = get_or_create(level2.children_[index_at(page, 2)], nodes_memory_);
+  return leaf.page_lists_[index_at(page, 3)];
+}
+
+void PageMapMemoryRegionToOwnerLinker::insert_into(page_list_type& page_list,
+    memory_region_to_owner_list_type::const_iterator memory_region_to_owner)
+{
+  // Keep the page list sorted by size, smallest first. Regions of the same size are either disjoint,
+  // in which case their order does not matter because at most one of them contains a given Item,
+  // or they cover the same memory, in which case the new region was registered inside the existing
+  // one and must be found first; hence the new region is put in front of regions of the same size.
+  size_t const size = size_of(memory_region_to_owner->memory_region());
+  auto pos = std::find_if(page_list.begin(), page_list.end(),
+      [size](memory_region_to_owner_list_type::const_iterator const& element){ return size_of(element->memory_region()) >= size; });
+
+  size_t const old_capacity = page_list.capacity();
+  page_list.insert(pos, memory_region_to_owner);
+  page_lists_memory_ += (page_list.capacity() - old_capacity) * sizeof(page_list_type::value_type);
+}
+
+uintptr_t PageMapMemoryRegionToOwnerLinker::first_mapped_page_of(MemoryRegion const& memory_region) const
+{
+  int const pages_per_unit_shift = unit_shift_ - page_shift;
+  uintptr_t const first_page = page_of(memory_region.begin());
+  uintptr_t const first_unit = first_page >> pages_per_unit_shift;
+  // The first unit of this shard at or after first_unit.
+  uintptr_t const unit = first_unit + (shard_ + number_of_shards_ - first_unit % number_of_shards_) % number_of_shards_;
+  return std::max(first_page, unit << pages_per_unit_shift);
+}
+
+template<typename FUNC>
+void PageMapMemoryRegionToOwnerLinker::for_each_mapped_page_of(MemoryRegion const& memory_region, FUNC func) const
+{
+  int const pages_per_unit_shift = unit_shift_ - page_shift;
+  uintptr_t const last_page = page_of(memory_region.end() - 1);
+  uintptr_t page = first_mapped_page_of(memory_region);
+  while (page <= last_page)
+  {
+    // Map the pages up till the end of the current unit, then skip to the next unit of this shard.
+    uintptr_t const unit = page >> pages_per_unit_shift;
+    uintptr_t const unit_last_page = std::min(last_page, ((unit + 1) << pages_per_unit_shift) - 1);
+    for (; page <= unit_last_page; ++page)
+      func(page);
+    page = (unit + number_of_shards_) << pages_per_unit_shift;
+  }
+}
+
+MemoryRegionToOwner const* PageMapMemoryRegionToOwnerLinker::inform_owner_of(Item* item, dot::NodePtr* node_ptr_ptr,
+    MemoryRegion* cacheable_region, int* depth) const
+{
+  DoutEntering(dc::notice, "PageMapMemoryRegionToOwnerLinker::inform_owner_of(" << item << ", " << node_ptr_ptr << ")");
+
+  MemoryRegion item_memory_region(reinterpret_cast<char*>(item), sizeof(Item));
+  uintptr_t const page = page_of(item_memory_region.begin());
+  page_list_type const* page_list = find_page_list(page);
+
+  // This can also happen when creating a temporary in the constructor of a class;
+  // in that case we don't add item to any graph until they are moved (or copied) into
+  // a memory region that belongs to a managed Class or Array, later on.
+  if (!page_list)
+    return nullptr;
+
+  // The part of this page in which every Item has the same innermost region, as far as we know so far.
+  char const* begin = reinterpret_cast<char const*>(page << page_shift);
+  char const* end = begin + (size_t{1} << page_shift);
+
+  bool innermost = true;
+  for (memory_region_to_owner_list_type::const_iterator const& element : *page_list)
+  {
+    if (depth)
+      ++*depth;
+    MemoryRegion const& memory_region = element->memory_region();
+    if (!memory_region.overlaps_with(item_memory_region))
+    {
+      // A smaller region in this page that does not contain item limits the cacheable region.
+      if (memory_region.end() <= item_memory_region.begin())
+        begin = std::max(begin, memory_region.end());
+      else
+        end = std::min(end, static_cast<char const*>(memory_region.begin()));
+      continue;
+    }
+    // Inform the owner of the innermost region, falling back to the owners of the regions that
+    // contain it in case it was already destructed (see MemoryRegionToOwnerLinker::inform_owner_of).
+    if (element->inform_owner(item_memory_region, node_ptr_ptr))
+    {
+      if (cacheable_region && innermost)
+      {
+        begin = std::max(begin, static_cast<char const*>(memory_region.begin()));
+        end = std::min(end, memory_region.end());
+        cacheable_region->critical_area_assign({const_cast<char*>(begin), static_cast<size_t>(end - begin)});
+      }
+      return &*element;
+    }
+    Dout(dc::notice, "owner of " << *element << " is gone; trying the next larger region.");
+    innermost = false;
+  }
+
+  return nullptr;
+}
+
+bool PageMapMemoryRegionToOwnerLinker::register_new_memory_region_for(MemoryRegion memory_region,
+    MemoryRegionOwner::handle_type owner)
+{
+  DoutEntering(dc::notice, "PageMapMemoryRegionToOwnerLinker::register_new_memory_region_for(" << memory_region << ", " << owner << ")");
+
+  // Nothing can be constructed inside an empty region.
+  if (size_of(memory_region) == 0)
+    return false;
+
+  uintptr_t const last_page = page_of(memory_region.end() - 1);
+
+  // Pages beyond the address space that the radix tree covers would alias pages inside it.
+  if (!in_range(last_page))
+    DoutFatal(dc::core, "PageMapMemoryRegionToOwnerLinker: " << memory_region << " lays beyond the " <<
+        (page_shift + number_of_levels * bits_per_level) << " bits of address space that are supported; "
+        "configure with -DOptionCppGraphvizLinkerBackend=map instead.");
+
+  // Any region that contains the new region also overlaps with its first mapped page.
+  bool nested = false;
+  if (page_list_type const* first_page_list = find_page_list(first_mapped_page_of(memory_region)))
+    nested = std::any_of(first_page_list->begin(), first_page_list->end(),
+        [&](memory_region_to_owner_list_type::const_iterator const& element){ return memory_region.lays_within(element->memory_region()); });
+
+  auto memory_region_to_owner =
+    memory_region_to_owner_list_.emplace(memory_region_to_owner_list_.end(), memory_region, owner);
+  for_each_mapped_page_of(memory_region, [&](uintptr_t page){ insert_into(get_page_list(page), memory_region_to_owner); });
+
+  Dout(dc::notice, "after:\n" << *this);
+
+  return nested;
+}
+
+void PageMapMemoryRegionToOwnerLinker::unregister_memory_region(MemoryRegion memory_region)
+{
+  DoutEntering(dc::notice, "PageMapMemoryRegionToOwnerLinker::unregister_memory_region(" << memory_region << ")");
+
+  if (size_of(memory_region) == 0)
+    return;
+
+  // Just like MemoryRegionToOwnerLinker, removing a region also removes all regions that
+  // were registered inside it. It is therefore possible that we fail to find a memory region
+  // because it fell inside another memory region that was already removed.
+  // See MemoryRegionToOwnerLinker::unregister_memory_region for how that can happen.
+  page_list_type const* first_page_list = find_page_list(first_mapped_page_of(memory_region));
+  if (!first_page_list ||
+      std::none_of(first_page_list->begin(), first_page_list->end(),
+        [&](memory_region_to_owner_list_type::const_iterator const& element){ return element->memory_region() == memory_region; }))
+    return;
+
+  // Remove memory_region and every region inside it from all page lists, remembering
+  // each removed region once (when visiting the first page of it that is mapped).
+  std::vector<memory_region_to_owner_list_type::const_iterator> removed;
+  for_each_mapped_page_of(memory_region, [&](uintptr_t page){
+    std::erase_if(get_page_list(page), [&](memory_region_to_owner_list_type::const_iterator const& element){
+          MemoryRegion const& element_memory_region = element->memory_region();
+          if (!element_memory_region.lays_within(memory_region))
+            return false;
+          if (first_mapped_page_of(element_memory_region) == page)
+            removed.push_back(element);
+          return true;
+        });
+  });
+  for (auto const& element : removed)
+    memory_region_to_owner_list_.erase(element);
+
+  Dout(dc::notice, "after:\n" << *this);
+}
+
+#ifdef CWDEBUG
+void PageMapMemoryRegionToOwnerLinker::print_on(std::ostream& os) const
+{
+  for (MemoryRegionToOwner const& memory_region_to_owner : memory_region_to_owner_list_)
+    os << memory_region_to_owner << '\n';
+  os << "memory overhead: " << memory_overhead() << " bytes.\n";
+}
+#endif
+
+} // namespace cppgraphviz
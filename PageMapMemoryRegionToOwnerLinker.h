@@ -0,0 +1,126 @@
+#pragma once
+
+#include "MemoryRegionToOwner.h"
+#include <array>
+#include <list>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#ifdef CWDEBUG
+#include "utils/has_print_on.h"
+#endif
+
+namespace cppgraphviz {
+#ifdef CWDEBUG
+using utils::has_print_on::operator<<;
+#endif
+
+class Item;
+
+// An alternative for MemoryRegionToOwnerLinker in the spirit of the pagemap of tcmalloc.
+//
+// A radix tree maps every page that is touched by a registered memory region to the list of
+// registered regions that overlap with that page. Each list is sorted by the size of the regions,
+// smallest first, so that the first region in the list of the page of an Item that contains
+// that Item is the innermost region containing it. Looking up the owner of an Item is therefore
+// a constant time walk down the radix tree followed by a scan of a (short) list.
+//
+// The price is memory: each page of a registered region costs one list entry, and the
+// nodes of the radix tree are never freed. Use memory_overhead() to keep an eye on that.
+//
+// When used as the linker of a shard of MemoryRegionToOwnerLinkerSingleton (see set_shard),
+// only the pages in the units of address space of that shard are mapped, so that the pages
+// of a region that spans several units are not mapped by every shard that it touches.
+//
+class PageMapMemoryRegionToOwnerLinker
+{
+ public:
+  static constexpr int page_shift = 12;                                 // 4 kiB pages.
+  static constexpr int bits_per_level = 9;
+  static constexpr int number_of_levels = 4;                            // Covers 12 + 4 * 9 = 48 bits of address space.
+  static constexpr size_t fanout = size_t{1} << bits_per_level;
+
+ private:
+  // The registered regions. The page lists refer to these elements, which therefore must be stable.
+  using memory_region_to_owner_list_type = std::list<MemoryRegionToOwner>;
+  using page_list_type = std::vector<memory_region_to_owner_list_type::const_iterator>;
+
+  struct Leaf
+  {
+    std::array<page_list_type, fanout> page_lists_;
+  };
+
+  template<typename Child>
+  struct Interior
+  {
+    std::array<std::unique_ptr<Child>, fanout> children_;
+  };
+
+  using level2_type = Interior<Leaf>;
+  using level1_type = Interior<level2_type>;
+  using root_type = Interior<level1_type>;
+
+  memory_region_to_owner_list_type memory_region_to_owner_list_;
+  root_type root_;
+
+  // Only the pages in units u (of 2^unit_shift_ bytes) with u % number_of_shards_ == shard_ are mapped.
+  int unit_shift_ = page_shift;
+  uintptr_t number_of_shards_ = 1;
+  uintptr_t shard_ = 0;
+
+  // The memory allocated for radix tree nodes and page list elements.
+  size_t nodes_memory_ = 0;
+  size_t page_lists_memory_ = 0;
+
+ private:
+  static uintptr_t page_of(char const* ptr) { return reinterpret_cast<uintptr_t>(ptr) >> page_shift; }
+  static bool in_range(uintptr_t page) { return (page >> (number_of_levels * bits_per_level)) == 0; }
+  static size_t size_of(MemoryRegion const& memory_region) { return memory_region.end() - memory_region.begin(); }
+
+  // Return the page list of page, or nullptr if there is none.
+  page_list_type const* find_page_list(uintptr_t page) const;
+  // Return the page list of page, creating the nodes leading to it if necessary.
+  page_list_type& get_page_list(uintptr_t page);
+
+  void insert_into(page_list_type& page_list, memory_region_to_owner_list_type::const_iterator memory_region_to_owner);
+
+  // Return the first page of memory_region that is mapped by this page map.
+  uintptr_t first_mapped_page_of(MemoryRegion const& memory_region) const;
+  // Call func(page) for every page of memory_region that is mapped by this page map.
+  template<typename FUNC>
+  void for_each_mapped_page_of(MemoryRegion const& memory_region, FUNC func) const;
+
+ public:
+  // Only map the pages in the units of 2^unit_shift bytes that shard (out of number_of_shards) handles.
+  // Must be called before any memory region is registered.
+  void set_shard(size_t shard, size_t number_of_shards, int unit_shift)
+  {
+    // Units can not be smaller than a page.
+    ASSERT(unit_shift >= page_shift && shard < number_of_shards && empty());
+    unit_shift_ = unit_shift;
+    number_of_shards_ = number_of_shards;
+    shard_ = shard;
+  }
+
+  // See MemoryRegionToOwnerLinker.
+  MemoryRegionToOwner const* inform_owner_of(Item* item, dot::NodePtr* node_ptr = nullptr, MemoryRegion* cacheable_region = nullptr,
+      int* depth = nullptr) const;
+  bool register_new_memory_region_for(MemoryRegion memory_region, MemoryRegionOwner::handle_type owner);
+  void unregister_memory_region(MemoryRegion memory_region);
+
+  bool empty() const { return memory_region_to_owner_list_.empty(); }
+
+  // The number of bytes used by the page map (the radix tree, the page lists and the list of registered regions).
+  size_t memory_overhead() const
+  {
+    // A node of a std::list has two pointers in front of the element.
+    size_t const list_memory = memory_region_to_owner_list_.size() * (2 * sizeof(void*) + sizeof(MemoryRegionToOwner));
+    return sizeof(root_) + nodes_memory_ + page_lists_memory_ + list_memory;
+  }
+
+#ifdef CWDEBUG
+  void print_on(std::ostream& os) const;
+#endif
+};
+
+} // namespace cppgraphviz
@@ -3,22 +3,111 @@
 #include "MemoryRegionToOwnerLinker.h"
 #include "Graph.h"
 #include "utils/pointer_hash.h"
+#include <algorithm>
+#include <cstddef>
 
 namespace cppgraphviz {
 
+void* TrackingArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+  DoutEntering(dc::notice, "TrackingArena::allocate(" << bytes << ", " << alignment << ")");
+
+  size_t chunk_size = std::max(minimum_chunk_size, chunk_size_factor * bytes);
+  if (!chunks_.empty())
+  {
+    Chunk& current = chunks_.back();
+    uintptr_t const chunk_begin = reinterpret_cast<uintptr_t>(current.begin_);
+    uintptr_t const aligned = (chunk_begin + current.used_ + alignment - 1) & ~(uintptr_t{alignment} - 1);
+    if (aligned + bytes <= chunk_begin + current.size_)
+    {
+      current.used_ = aligned + bytes - chunk_begin;
+      ++current.live_allocations_;
+      return reinterpret_cast<void*>(aligned);
+    }
+    // Grow the chunks geometrically, also when the buffers grow slower than that.
+    chunk_size = std::max(chunk_size, 2 * current.size_);
+    // The current chunk is no longer used for new buffers; free it if it is empty.
+    if (current.live_allocations_ == 0)
+    {
+      free_chunk(current);
+      chunks_.pop_back();
+    }
+  }
+
+  size_t const chunk_alignment = std::max(alignment, alignof(std::max_align_t));
+  char* chunk_begin = allocate_chunk(chunk_size, chunk_alignment);
+  chunks_.push_back({chunk_begin, chunk_size, chunk_alignment, bytes, 1});
+  return chunk_begin;
+}
+
+char* TrackingArena::allocate_chunk(size_t size, size_t alignment)
+{
+  char* chunk_begin = static_cast<char*>(upstream_->allocate(size, alignment));
+  owner_->register_new_memory_region({chunk_begin, size});
+  return chunk_begin;
+}
+
+void TrackingArena::deallocate(void* ptr)
+{
+  DoutEntering(dc::notice, "TrackingArena::deallocate(" << ptr << ")");
+
+  auto chunk = std::find_if(chunks_.begin(), chunks_.end(),
+      [ptr](Chunk const& chunk){ return chunk.begin_ <= ptr && ptr < chunk.begin_ + chunk.size_; });
+  // Deallocating a buffer that wasn't allocated by this arena?
+  ASSERT(chunk != chunks_.end());
+
+  if (--chunk->live_allocations_ > 0)
+    return;
+
+  // Keep a small current chunk around to be reused from the start.
+  if (chunk == chunks_.end() - 1 && chunk->size_ == minimum_chunk_size)
+    chunk->used_ = 0;
+  else
+  {
+    free_chunk(*chunk);
+    chunks_.erase(chunk);
+  }
+}
+
+void TrackingArena::free_chunk(Chunk const& chunk)
+{
+  IndexedContainerMemoryRegionOwner::unregister_memory_region({chunk.begin_, chunk.size_}, MemoryRegionSource::TrackingAllocator);
+  upstream_->deallocate(chunk.begin_, chunk.size_, chunk.alignment_);
+}
+
+TrackingArena::~TrackingArena()
+{
+  for (Chunk const& chunk : chunks_)
+  {
+    // The vector should have deallocated all its buffers by now.
+    ASSERT(chunk.live_allocations_ == 0);
+    free_chunk(chunk);
+  }
+}
+
 void* TrackingAllocator::do_allocate(std::size_t bytes, std::size_t alignment)
 {
   Dout(dc::notice, "do_allocate(" << bytes << ", " << alignment << ")");
-  void* ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+#ifdef CPPGRAPHVIZ_POOLED_VECTOR_ALLOCATOR
+  void* ptr = arena_.allocate(bytes, alignment);
+#else
+  void* ptr = upstream_->allocate(bytes, alignment);
   owner_->register_new_memory_region({static_cast<char*>(ptr), bytes});
+#endif
+  owner_->allocated({}, {static_cast<char*>(ptr), bytes});
   return ptr;
 }
 
 void TrackingAllocator::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
 {
   Dout(dc::notice, "do_deallocate(" << ptr << ", " << bytes << ", " << alignment << ")");
-  IndexedContainerMemoryRegionOwner::unregister_memory_region({static_cast<char*>(ptr), bytes});
-  return std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+  owner_->deallocating({}, {static_cast<char*>(ptr), bytes});
+#ifdef CPPGRAPHVIZ_POOLED_VECTOR_ALLOCATOR
+  arena_.deallocate(ptr);
+#else
+  IndexedContainerMemoryRegionOwner::unregister_memory_region({static_cast<char*>(ptr), bytes}, MemoryRegionSource::TrackingAllocator);
+  return upstream_->deallocate(ptr, bytes, alignment);
+#endif
 }
 
 } // namespace cppgraphviz
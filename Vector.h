@@ -1,13 +1,21 @@
 #pragma once
 
+#ifdef CPPGRAPHVIZ_DISABLE_TRACKING
+#include "NullTracking.h"
+#else // CPPGRAPHVIZ_DISABLE_TRACKING
+
 #include "LabelNode.h"
 #include "get_index_label.h"
 #include "IndexedContainerSet.h"
 #include "IndexedContainerMemoryRegionOwner.h"
 #include "dot/TableNode.h"
 #include "utils/Vector.h"
+#include "utils/Badge.h"
 #include "utils/has_print_on.h"
+#include <iterator>
 #include <memory_resource>
+#include <type_traits>
+#include <vector>
 #include "debug.h"
 
 #ifdef CWDEBUG
@@ -17,13 +25,71 @@
 namespace cppgraphviz {
 using utils::has_print_on::operator<<;
 
+// Used by TrackingAllocator when CPPGRAPHVIZ_POOLED_VECTOR_ALLOCATOR is defined.
+//
+// Hands out buffers from chunks, each of which is registered as a single memory region of owner_.
+// Buffers are bump allocated from the current chunk. If a buffer does not fit, a new current chunk
+// is allocated that is at least chunk_size_factor times as large as that buffer and at least twice
+// as large as the previous chunk, so that a vector that grows from empty to N elements allocates
+// and registers only about log2(N) / 2 chunks.
+//
+// Space is only reclaimed when all buffers of a chunk are deallocated: the chunk is then
+// unregistered and returned to upstream, except a current chunk of minimum_chunk_size bytes,
+// which is reused from the start. For a vector that doubles its capacity the chunks therefore
+// hold up to chunk_size_factor times its capacity (but at least minimum_chunk_size bytes).
+class TrackingArena
+{
+ private:
+  static constexpr size_t minimum_chunk_size = 4096;
+  static constexpr size_t chunk_size_factor = 4;
+
+  struct Chunk
+  {
+    char* begin_;
+    size_t size_;
+    size_t alignment_;
+    size_t used_;                       // The number of bytes at the start of the chunk that were handed out.
+    size_t live_allocations_;           // The number of buffers in this chunk that were not deallocated yet.
+  };
+
+  IndexedContainerMemoryRegionOwner* owner_;
+  std::pmr::memory_resource* upstream_; // Where the chunks are allocated from.
+  std::vector<Chunk> chunks_;           // The last chunk is the current one.
+
+ private:
+  char* allocate_chunk(size_t size, size_t alignment);
+  void free_chunk(Chunk const& chunk);
+
+ public:
+  TrackingArena(IndexedContainerMemoryRegionOwner* owner, std::pmr::memory_resource* upstream) :
+    owner_(owner), upstream_(upstream) { }
+  ~TrackingArena();
+
+  void* allocate(std::size_t bytes, std::size_t alignment);
+  void deallocate(void* ptr);
+};
+
+// A memory resource that allocates from upstream and registers the allocated memory
+// as memory region of owner. Upstream is not owned and must outlive the allocator.
 class TrackingAllocator : public std::pmr::memory_resource
 {
  private:
   IndexedContainerMemoryRegionOwner* owner_;
+  std::pmr::memory_resource* upstream_;
+#ifdef CPPGRAPHVIZ_POOLED_VECTOR_ALLOCATOR
+  TrackingArena arena_;
+#endif
 
  public:
-  TrackingAllocator(IndexedContainerMemoryRegionOwner* owner) : owner_(owner) { }
+#ifdef CPPGRAPHVIZ_POOLED_VECTOR_ALLOCATOR
+  TrackingAllocator(IndexedContainerMemoryRegionOwner* owner, std::pmr::memory_resource* upstream) :
+    owner_(owner), upstream_(upstream), arena_(owner, upstream) { }
+#else
+  TrackingAllocator(IndexedContainerMemoryRegionOwner* owner, std::pmr::memory_resource* upstream) :
+    owner_(owner), upstream_(upstream) { }
+#endif
+
+  std::pmr::memory_resource* upstream_resource() const { return upstream_; }
 
  protected:
   void* do_allocate(std::size_t bytes, std::size_t alignment) override;
@@ -47,24 +113,37 @@ class VectorMemoryRegionOwner : public IndexedContainerMemoryRegionOwner
  protected:
   VectorMemoryRegionOwner(std::weak_ptr<GraphTracker> const& root_graph, size_t element_size, size_t number_of_elements,
       get_begin_type get_begin,
-      std::type_info const& index_type_info, std::string const& demangled_index_type_name, std::string_view what) :
+      IndexTypeLabel const* index_type_label, std::string_view what,
+      std::pmr::memory_resource* upstream) :
     IndexedContainerMemoryRegionOwner(root_graph, element_size, number_of_elements, get_begin,
-        index_type_info, demangled_index_type_name, what), allocator_(this) { }
+        index_type_label, what), allocator_(this, upstream) { }
 
   VectorMemoryRegionOwner(threadsafe::LockFinalCopy<IndexedContainerMemoryRegionOwner> other,
-      std::type_info const& index_type_info, std::string_view what) :
-    IndexedContainerMemoryRegionOwner(other, index_type_info, what), allocator_(this) { }
+      IndexTypeLabel const* index_type_label, std::string_view what, std::pmr::memory_resource* upstream) :
+    IndexedContainerMemoryRegionOwner(other, index_type_label, what), allocator_(this, upstream) { }
 
   VectorMemoryRegionOwner(threadsafe::LockFinalMove<IndexedContainerMemoryRegionOwner> other,
-      std::string_view what) :
-    IndexedContainerMemoryRegionOwner(other, what), allocator_(this) { }
+      std::string_view what, std::pmr::memory_resource* upstream) :
+    IndexedContainerMemoryRegionOwner(other, what), allocator_(this, upstream) { }
+
+ public:
+  // The memory resource that the elements are allocated from.
+  std::pmr::memory_resource* upstream_resource() const { return allocator_.upstream_resource(); }
 };
 
-template <typename T, typename _Index = utils::VectorIndex<T>>
+// _Alloc only selects the interface: pass std::pmr::polymorphic_allocator<T> to opt in to the constructor
+// that takes an upstream memory resource. The elements are always allocated through a TrackingAllocator,
+// from std::pmr::new_delete_resource() unless another upstream was passed.
+// When tracking is disabled, _Alloc is the allocator of the utils::Vector (see NullTracking.h).
+template <typename T, typename _Index = utils::VectorIndex<T>, typename _Alloc = std::allocator<T>>
 class Vector : public VectorMemoryRegionOwner, public utils::Vector<T, _Index, std::pmr::polymorphic_allocator<T>>
 {
+  static_assert(std::is_same_v<_Alloc, std::allocator<T>> || std::is_same_v<_Alloc, std::pmr::polymorphic_allocator<T>>,
+      "The allocator of a cppgraphviz::Vector must be std::allocator<T> or std::pmr::polymorphic_allocator<T>.");
+
  public:
   using _Base = utils::Vector<T, _Index, std::pmr::polymorphic_allocator<T>>;
+  static constexpr bool has_upstream = std::is_same_v<_Alloc, std::pmr::polymorphic_allocator<T>>;
 
   static char const* get_begin(IndexedContainerMemoryRegionOwner const* self)
   {
@@ -88,49 +167,128 @@ class Vector : public VectorMemoryRegionOwner, public utils::Vector<T, _Index, s
   }
 
   Vector(std::weak_ptr<GraphTracker> const& root_graph, std::initializer_list<T> ilist, std::string_view what) :
+    Vector(root_graph, ilist, what, std::pmr::new_delete_resource(), utils::Badge<Vector>{}) { }
+
+  // The elements are allocated from upstream, which must outlive the Vector.
+  Vector(std::weak_ptr<GraphTracker> const& root_graph, std::initializer_list<T> ilist, std::string_view what,
+      std::pmr::memory_resource* upstream) requires has_upstream :
+    Vector(root_graph, ilist, what, upstream, utils::Badge<Vector>{}) { }
+
+ private:
+  Vector(std::weak_ptr<GraphTracker> const& root_graph, std::initializer_list<T> ilist, std::string_view what,
+      std::pmr::memory_resource* upstream, utils::Badge<Vector>) :
     VectorMemoryRegionOwner(root_graph, sizeof(T), ilist.size(),
         &Vector::get_begin,
-        typeid(_Index), get_index_label<_Index>(), what),
+        index_type_label<_Index>(), what, upstream),
     _Base(ilist, &allocator_)
   {
     // Now that the utils::Vector is initialized set this function pointer, so that
     // future calls to IndexedContainerMemoryRegionOwner::on_memory_region_usage will
     // get the correct value instead of the initial size.
     get_number_of_elements_ = &Vector::get_number_of_elements;
+    end_bulk_construction();
   }
 
+ public:
   Vector(Vector const& other, std::string_view what) :
-    VectorMemoryRegionOwner(other, typeid(_Index), what),
+    VectorMemoryRegionOwner(other, index_type_label<_Index>(), what, other.upstream_resource()),
     _Base(other, &allocator_)
   {
     get_number_of_elements_ = &Vector::get_number_of_elements;
+    end_bulk_construction();
   }
 
 #ifdef CPPGRAPHVIZ_USE_WHAT
   Vector(Vector const& other) :
-    VectorMemoryRegionOwner(other, typeid(_Index), "Vector(Vector const&) of " + other.get_what()),
+    VectorMemoryRegionOwner(other, index_type_label<_Index>(), "Vector(Vector const&) of " + other.get_what(), other.upstream_resource()),
     _Base(other, &allocator_)
   {
     get_number_of_elements_ = &Vector::get_number_of_elements;
+    end_bulk_construction();
   }
 #endif
 
   Vector(Vector&& other, std::string_view what) :
-    VectorMemoryRegionOwner(std::move(other), what),
+    VectorMemoryRegionOwner(std::move(other), what, other.upstream_resource()),
     _Base(std::move(other), &allocator_)
   {
     get_number_of_elements_ = &Vector::get_number_of_elements;
+    end_bulk_construction();
   }
 
 #ifdef CPPGRAPHVIZ_USE_WHAT
   Vector(Vector&& other) :
-    VectorMemoryRegionOwner(std::move(other), "Vector(Vector&&) of " + other.get_what()),
+    VectorMemoryRegionOwner(std::move(other), "Vector(Vector&&) of " + other.get_what(), other.upstream_resource()),
     _Base(std::move(other), &allocator_)
   {
     get_number_of_elements_ = &Vector::get_number_of_elements;
+    end_bulk_construction();
   }
 #endif
 
+  // The following member functions detach and/or construct their elements in bulk.
+
+  void clear()
+  {
+    detach_elements(0);
+    _Base::clear();
+  }
+
+  void resize(typename _Base::size_type count)
+  {
+    if (count < _Base::size())
+      detach_elements(count);
+    BulkConstruction bulk_construction(this);
+    _Base::resize(count);
+  }
+
+  void resize(typename _Base::size_type count, T const& value)
+  {
+    if (count < _Base::size())
+      detach_elements(count);
+    BulkConstruction bulk_construction(this);
+    _Base::resize(count, value);
+  }
+
+  void assign(typename _Base::size_type count, T const& value)
+  {
+    if (count < _Base::size())
+      detach_elements(count);
+    BulkConstruction bulk_construction(this);
+    _Base::assign(count, value);
+  }
+
+  template<typename InputIt>
+  void assign(InputIt first, InputIt last)
+  {
+    if constexpr (std::forward_iterator<InputIt>)
+    {
+      size_t const count = std::distance(first, last);
+      if (count < _Base::size())
+        detach_elements(count);
+      BulkConstruction bulk_construction(this);
+      _Base::assign(first, last);
+    }
+    else
+    {
+      // The number of elements is not known in advance for single pass input iterators:
+      // the surplus elements are destroyed first and then removed by end_bulk_construction (see resize_table).
+      {
+        BulkConstruction bulk_construction(this);
+        _Base::assign(first, last);
+      }
+      detach_elements(_Base::size());
+    }
+  }
+
+  void assign(std::initializer_list<T> ilist)
+  {
+    if (ilist.size() < _Base::size())
+      detach_elements(ilist.size());
+    BulkConstruction bulk_construction(this);
+    _Base::assign(ilist);
+  }
+
 #ifdef CWDEBUG
  public:
   void print_on(std::ostream& os) const override
@@ -141,3 +299,5 @@ class Vector : public VectorMemoryRegionOwner, public utils::Vector<T, _Index, s
 };
 
 } // namespace cppgraphviz
+
+#endif // CPPGRAPHVIZ_DISABLE_TRACKING
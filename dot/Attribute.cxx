@@ -43,8 +43,9 @@ bool has_non_escaped_chars(std::string_view sv)
   return saw_backslash;
 }
 
+// Write s to os, adding quotes when needed.
 // Allow the user to add quotes around a string themselves.
-std::string quoted(std::string const& s, bool no_quotes_required = false)
+void write_quoted(std::ostream& os, std::string const& s, bool no_quotes_required = false)
 {
   bool has_quotes = s.size() >= 2 && s[0] == '"' && s[s.size() - 1] == '"';
 
@@ -54,7 +55,10 @@ std::string quoted(std::string const& s, bool no_quotes_required = false)
     sv.remove_prefix(1);
     sv.remove_suffix(1);
     if (!has_non_escaped_chars(sv))
-      return s;                         // Return as-is: is already quoted and does not contain internal quotes. For example: '"hello"' or '"hel\"lo\\"'.
+    {
+      os << s;                          // Write as-is: is already quoted and does not contain internal quotes. For example: '"hello"' or '"hel\"lo\\"'.
+      return;
+    }
   }
   // If we get here the string either has no quotes are both start and end, or contains an unescaped
   // quote in the middle and/or an unescaped backslash at the end (which then escapes the trailing quote).
@@ -67,19 +71,25 @@ std::string quoted(std::string const& s, bool no_quotes_required = false)
   // In all of these cases, except the first, no_quotes_required will be false.
 
   if (no_quotes_required)
-    return s;                           // Return as-is: the string only contains alpha-numeric characters and underscores, and no quotes are required.
+  {
+    os << s;                            // Write as-is: the string only contains alpha-numeric characters and underscores, and no quotes are required.
+    return;
+  }
 
   // Add quotes and escape any existing quotes and/or backslashes.
-  std::string result;
-  result = '"';
-  for (char const c : s)
+  os.put('"');
+  size_t begin = 0;
+  for (size_t i = 0; i < s.size(); ++i)
   {
-    if (c == '"' || c == '\\')
-      result += '\\';
-    result += c;
+    if (s[i] != '"' && s[i] != '\\')
+      continue;
+    // Write everything up till here, then the backslash; s[i] is written as part of the next run.
+    os.write(s.data() + begin, i - begin);
+    os.put('\\');
+    begin = i;
   }
-  result += '"';
-  return result;
+  os.write(s.data() + begin, s.size() - begin);
+  os.put('"');
 }
 
 void Attribute::print_on(std::ostream& os) const
@@ -87,7 +97,9 @@ void Attribute::print_on(std::ostream& os) const
   bool no_quotes_required = is_valid_ID(key_);
 
   // ID '=' ID
-  os << quoted(key_, no_quotes_required) << '=' << quoted(value_);
+  write_quoted(os, key_, no_quotes_required);
+  os.put('=');
+  write_quoted(os, value_);
 }
 
 } // namespace cppgraphviz::dot
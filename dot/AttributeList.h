@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Attribute.h"
+#include <cstdint>
 #include <iosfwd>
 #include <set>
 
@@ -10,23 +11,30 @@ class AttributeList
 {
  private:
   std::set<Attribute> attributes_;      // AttributeList itself should be locked before accessed, so this std::set is threadsafe too.
+  uint64_t version_ = 0;                // Incremented every time attributes_ changes.
 
  public:
   void add(Attribute&& attribute)
   {
-    attributes_.insert(std::move(attribute));
+    if (attributes_.insert(std::move(attribute)).second)
+      ++version_;
   }
 
   void remove(Attribute const& key)
   {
-    attributes_.erase(key);
+    if (attributes_.erase(key) > 0)
+      ++version_;
   }
 
   void remove(std::string_view key)
   {
-    attributes_.erase(key);
+    if (attributes_.erase(key) > 0)
+      ++version_;
   }
 
+  // A value that changes whenever an attribute is added or removed.
+  uint64_t version() const { return version_; }
+
   bool has_key(std::string_view key) const;
   std::string_view get_value(std::string_view key) const;
 
@@ -55,7 +63,8 @@ class AttributeList
   AttributeList& operator+=(std::initializer_list<Attribute> list)
   {
     for (Attribute const& attribute : list)
-      attributes_.insert(attribute);
+      if (attributes_.insert(attribute).second)
+        ++version_;
     return *this;
   }
 
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <utils/UniqueID.h>     // Add https://github.com/CarloWood/ai-utils.git to the root of your project.
+#include <charconv>
 #include <cstdint>
+#include <limits>
+#include <ostream>
 
 namespace cppgraphviz::dot {
 
@@ -9,4 +12,21 @@ using ID_type = uint32_t;
 using DotID_type = utils::UniqueID<ID_type>;
 extern utils::UniqueIDContext<ID_type> s_unique_id_context;
 
+// Write n to an ostream as a decimal number, using std::to_chars instead of the (locale dependent) formatting of the stream.
+//
+// Usage:
+//   os << Decimal{item->dot_id()};
+struct Decimal
+{
+  uint64_t n_;
+
+  friend std::ostream& operator<<(std::ostream& os, Decimal const& decimal)
+  {
+    char buf[std::numeric_limits<uint64_t>::digits10 + 1];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), decimal.n_);
+    os.write(buf, end - buf);
+    return os;
+  }
+};
+
 } // namespace cppgraphviz::dot
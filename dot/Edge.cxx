@@ -11,13 +11,26 @@ void EdgeItem::set_nodes(Port const& from, Port const& to)
   to_ = to;
 }
 
+uint64_t EdgeItem::version() const
+{
+  uint64_t version = attribute_list().version();
+  for (Port const* port : { &from_, &to_ })
+  {
+    version = version_combine(version, port->id());
+    version = version_combine(version, port->has_port() ? port->port() + 1 : 0);
+  }
+  return version;
+}
+
 void EdgeItem::write_dot_to(std::ostream& os, std::string& indentation) const
 {
   bool digraph = DigraphIomanip::get_iword_value(os);
 
   // edge_stmt	:	(node_id | subgraph) edgeRHS [ attr_list ]
   // edgeRHS	:	edgeop (node_id | subgraph) [ edgeRHS ]
-  os << indentation << from_port() << (digraph ? " -> " : " -- ") << to_port() << " [" << attribute_list() << "]\n";
+  output_cache_.write_to(os, version_combine(version(), digraph), indentation.size(), [&](std::ostream& output){
+    output << indentation << from_port() << (digraph ? " -> " : " -- ") << to_port() << " [" << attribute_list() << "]\n";
+  });
 }
 
 } // namespace cppgraphviz::dot
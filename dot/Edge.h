@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Item.h"
+#include "OutputCache.h"
 #include "Port.h"
 #include <concepts>
 #include <type_traits>
@@ -17,6 +18,8 @@ class EdgeItem : public Item
   Port from_;
   Port to_;
 
+  mutable OutputCache output_cache_;            // The output of the last call to write_dot_to.
+
  public:
   void set_nodes(Port const& from, Port const& to);
 
@@ -25,6 +28,7 @@ class EdgeItem : public Item
 
   item_type_type item_type() const override { return item_type_edge; }
   void write_dot_to(std::ostream& os, std::string& indentation) const override;
+  uint64_t version() const override;
 };
 
 template<typename T>
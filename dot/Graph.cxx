@@ -1,6 +1,8 @@
 #include "sys.h"
 #include "Graph.h"
+#include <algorithm>
 #include <iostream>
+#include <vector>
 #include "debug.h"
 
 namespace cppgraphviz::dot {
@@ -58,7 +60,7 @@ void GraphItem::write_dot(std::ostream& os) const
     os << "strict ";
   if (digraph_)
     os << "di";
-  os << "graph " << dot_id() << " {\n";
+  os << "graph " << Decimal{dot_id()} << " {\n";
   if (rankdir_ != TB)
   {
     os << "  rankdir=";
@@ -74,13 +76,20 @@ void GraphItem::write_dot(std::ostream& os) const
   if (concentrate_)
     os << "  concentrate=true\n";
 
-  write_body_to(os);
+  // The items write directly to os; tell the edges whether this is a digraph and the tables what the rankdir is.
+  bool const was_digraph = DigraphIomanip::get_iword_value(os);
+  RankDir const old_rankdir = RankdirIomanip::get_iword_value(os);
+  os << DigraphIomanip{digraph_} << RankdirIomanip{rankdir_};
+  std::string indentation = "  ";
+  write_attributes_to(os, indentation);
+  write_items_to(os, indentation);
+  os << DigraphIomanip{was_digraph} << RankdirIomanip{old_rankdir};
 
   // Close the [di]graph.
   os << '}' << std::endl;
 }
 
-void GraphItem::write_body_to(std::ostream& os, std::string indentation) const
+void GraphItem::write_attributes_to(std::ostream& os, std::string const& indentation) const
 {
   // stmt_list	:	[ stmt [ ';' ] stmt_list ]
   // stmt	:	node_stmt
@@ -89,8 +98,6 @@ void GraphItem::write_body_to(std::ostream& os, std::string indentation) const
   //            |       ID '=' ID
   //            |       subgraph
 
-  indentation += "  ";
-
   // Write default attributes.
   if (attribute_list())
     os << indentation << "graph [" << attribute_list() << "]\n";
@@ -98,34 +105,78 @@ void GraphItem::write_body_to(std::ostream& os, std::string indentation) const
     os << indentation << "node [" << node_attribute_list_ << "]\n";
   if (edge_attribute_list_)
     os << indentation << "edge [" << edge_attribute_list_ << "]\n";
+}
 
-  std::map<item_type_type, std::string> output;
-
-  // Write all items to the output map, sorting them by item_type.
-  for (auto const& item_pair : items_)
+void GraphItem::write_items_to(std::ostream& os, std::string& indentation) const
+{
+  // Sort the items by item_type before writing them, so that all nodes, tables, subgraphs and edges are grouped.
+  // The sort is stable: items of the same type are written in the order of their ID.
+  // The item type of an item never changes, so this only has to be done again when items were added or removed.
+  if (!sorted_items_valid_)
   {
-    std::ostringstream oss;
-    if (digraph_)
-      oss << digraph;
-    Item::unlocked_type::crat item_r(item_pair.second.item());
-    item_r->write_dot_to(oss, indentation);
-    auto ibp = output.try_emplace(item_r->item_type());
-    ibp.first->second.append(oss.str());
+    std::vector<std::pair<item_type_type, ConstItemPtr const*>> sorted_items;
+    sorted_items.reserve(items_.size());
+    for (auto const& item_pair : items_)
+      sorted_items.emplace_back(Item::unlocked_type::crat{item_pair.second.item()}->item_type(), &item_pair.second);
+    std::stable_sort(sorted_items.begin(), sorted_items.end(),
+        [](auto const& lhs, auto const& rhs){ return lhs.first < rhs.first; });
+    sorted_items_.clear();
+    sorted_items_.reserve(sorted_items.size());
+    for (auto const& item_type_item_ptr_pair : sorted_items)
+      sorted_items_.push_back(item_type_item_ptr_pair.second);
+    sorted_items_valid_ = true;
   }
 
-  // Write output to os.
-  for (auto item_type_string_pair : output)
-    os << item_type_string_pair.second;
+  // Write all items directly to os.
+  for (ConstItemPtr const* item_ptr : sorted_items_)
+    Item::unlocked_type::crat{item_ptr->item()}->write_dot_to(os, indentation);
+}
+
+uint64_t GraphItem::version() const
+{
+  // This doesn't depend on the items: write_dot_to combines it with items_generation_ where needed.
+  uint64_t version = attribute_list().version();
+  version = version_combine(version, node_attribute_list_.version());
+  version = version_combine(version, edge_attribute_list_.version());
+  version = version_combine(version, digraph_ | strict_ << 1 | concentrate_ << 2 | rankdir_ << 3);
+  return version;
+}
+
+void GraphItem::write_head_to(std::ostream& os, std::string& indentation) const
+{
+  os << indentation << "subgraph " << Decimal{dot_id()} << " {\n";
+  indentation += "  ";
+  write_attributes_to(os, indentation);
+  indentation.resize(indentation.size() - 2);
 }
 
 void GraphItem::write_dot_to(std::ostream& os, std::string& indentation) const
 {
-  os << indentation << "subgraph " << dot_id() << " {\n";
-  write_body_to(os, indentation);
-  os << indentation << "}\n";
+  auto write_items_and_tail_to = [&](std::ostream& output){
+    indentation += "  ";
+    write_items_to(output, indentation);
+    indentation.resize(indentation.size() - 2);
+    output << indentation << "}\n";
+  };
+
+  if (subtree_cache_enabled_)
+  {
+    // If nothing in this subgraph changed since the last time, write all of it with a single copy.
+    output_cache_.write_to(os, version_combine(version(), items_generation_), indentation.size(), [&](std::ostream& output){
+      write_head_to(output, indentation);
+      write_items_and_tail_to(output);
+    });
+    return;
+  }
+
+  // Nothing tells us when an item changes: only write the head of this subgraph again if it changed since the last time,
+  // and stream the items, each from its own cache, instead of caching them again as part of this subgraph.
+  output_cache_.write_to(os, version(), indentation.size(), [&](std::ostream& output){ write_head_to(output, indentation); });
+  write_items_and_tail_to(os);
 }
 
 utils::iomanip::Index DigraphIomanip::s_index;
+utils::iomanip::Index RankdirIomanip::s_index;
 DigraphIomanip digraph;
 
 } // namespace cppgraphviz::dot
@@ -4,9 +4,11 @@
 #include "Node.h"
 #include "Edge.h"
 #include "TableNode.h"
+#include "OutputCache.h"
 #include <utils/iomanip.h>
 #include <string>
 #include <map>
+#include <vector>
 #include <iosfwd>
 
 namespace cppgraphviz::dot {
@@ -59,8 +61,27 @@ class GraphItem : public Item
   // The list of all (sub)graphs of this graph, by ID.
   std::map<DotID_type, ConstItemPtr> items_;
 
+  // The items of items_, sorted by item type, so that all nodes, tables, subgraphs and edges are written grouped.
+  // Only valid while sorted_items_valid_ is set; reset when an item is added or removed.
+  mutable std::vector<ConstItemPtr const*> sorted_items_;
+  mutable bool sorted_items_valid_ = false;
+
+  // Set if the owner of this graph calls mark_items_changed whenever the output of one of its items changes.
+  bool subtree_cache_enabled_ = false;
+  // Incremented when an item is added or removed, or mark_items_changed is called.
+  uint64_t items_generation_ = 0;
+
+  // The output of the last call to write_dot_to: the whole subgraph if subtree_cache_enabled_ is set,
+  // otherwise only its head and default attributes.
+  mutable OutputCache output_cache_;
+
  private:
-  void write_body_to(std::ostream& os, std::string indentation = {}) const;
+  // Write "subgraph ID {" and the default attributes of this graph to os.
+  void write_head_to(std::ostream& os, std::string& indentation) const;
+  // Write the default attributes of this graph to os.
+  void write_attributes_to(std::ostream& os, std::string const& indentation) const;
+  // Write all items to os; every item uses its own output cache, if any.
+  void write_items_to(std::ostream& os, std::string& indentation) const;
 
  public:
   //---------------------------------------------------------------------------
@@ -69,6 +90,12 @@ class GraphItem : public Item
   void set_strict(bool strict = true) { strict_ = strict; }
   void set_concentrate(bool concentrate) { concentrate_ = concentrate; }
 
+  // Let write_dot_to reuse the output of the whole subgraph as long as nothing in it changed.
+  // Only call this if mark_items_changed is called whenever the output of one of the items changes,
+  // including the items of subgraphs.
+  void enable_subtree_cache() { subtree_cache_enabled_ = true; }
+  void mark_items_changed() { ++items_generation_; }
+
   // Write graph to os in dot format.
   void write_dot(std::ostream& os) const;
 
@@ -91,6 +118,8 @@ class GraphItem : public Item
     auto ibp = items_.try_emplace(item_r->dot_id(), item);
     // Do not add the same graph item twice.
     ASSERT(ibp.second);
+    sorted_items_valid_ = false;
+    ++items_generation_;
     if constexpr (std::is_base_of_v<std::remove_cvref_t<decltype(*item_r)>, GraphItem>)
     {
       if (item_r->is_graph())
@@ -114,6 +143,8 @@ class GraphItem : public Item
     bool erased = items_.erase(item_r->dot_id());
     // That's unexpected... we shouldn't be calling remove_graph_item unless it is there.
     ASSERT(erased);
+    sorted_items_valid_ = false;
+    ++items_generation_;
   }
 
   template<typename ACCESS_TYPE>
@@ -161,6 +192,7 @@ class GraphItem : public Item
 
   item_type_type item_type() const override { return item_type_graph; }
   void write_dot_to(std::ostream& os, std::string& indentation) const override;
+  uint64_t version() const override;
 };
 
 class GraphPtr : public ItemPtrTemplate<GraphItem>
@@ -194,11 +226,23 @@ class DigraphIomanip : public utils::iomanip::Sticky
   static utils::iomanip::Index s_index;
 
  public:
-  DigraphIomanip() : Sticky(s_index, 1L) { }
+  DigraphIomanip(bool digraph = true) : Sticky(s_index, digraph ? 1L : 0L) { }
 
   static long get_iword_value(std::ostream& os) { return get_iword_from(os, s_index); }
 };
 
+// The rankdir of the root graph, for the items that are written differently depending on it.
+class RankdirIomanip : public utils::iomanip::Sticky
+{
+ private:
+  static utils::iomanip::Index s_index;
+
+ public:
+  RankdirIomanip(RankDir rankdir) : Sticky(s_index, rankdir) { }
+
+  static RankDir get_iword_value(std::ostream& os) { return static_cast<RankDir>(get_iword_from(os, s_index)); }
+};
+
 extern DigraphIomanip digraph;
 
 } // namespace cppgraphviz::dot
@@ -4,6 +4,8 @@
 #include "item_types.h"
 #include <threadsafe/threadsafe.h>
 #include <threadsafe/AIMutex.h>
+#include <cstdint>
+#include <string>
 #include "debug.h"
 
 namespace cppgraphviz::dot {
@@ -16,6 +18,12 @@ using ItemLockingPolicy = threadsafe::policy::Primitive<std::mutex>;
 
 class GraphItem;
 
+// Combine a version (see Item::version) with value.
+inline uint64_t version_combine(uint64_t version, uint64_t value)
+{
+  return version ^ (value + 0x9e3779b97f4a7c15 + (version << 6) + (version >> 2));
+}
+
 // Base class of GraphItem, EdgeItem and NodeItem.
 //
 // This class provides a unique id for each graph (item) and a general attribute list.
@@ -33,6 +41,10 @@ class Item : public AIRefCount, public ItemID
 
   virtual item_type_type item_type() const = 0;
   virtual void write_dot_to(std::ostream& os, std::string& indentation) const = 0;
+
+  // Return a value that changes whenever the output that write_dot_to writes for this item itself changes.
+  // This must be cheap: it does not include the output of other items, like the items of a graph.
+  virtual uint64_t version() const { return attribute_list().version(); }
 };
 
 } // namespace cppgraphviz::dot
@@ -6,7 +6,9 @@ namespace cppgraphviz::dot {
 void NodeItem::write_dot_to(std::ostream& os, std::string& indentation) const
 {
   // node_stmt	:	node_id [ attr_list ]
-  os << indentation << dot_id() << " [" << attribute_list() << "]\n";
+  output_cache_.write_to(os, version(), indentation.size(), [&](std::ostream& output){
+    output << indentation << Decimal{dot_id()} << " [" << attribute_list() << "]\n";
+  });
 }
 
 } // namespace cppgraphviz::dot
@@ -2,6 +2,7 @@
 
 #include "Item.h"
 #include "ItemPtr.h"
+#include "OutputCache.h"
 #include <concepts>
 #include <type_traits>
 
@@ -14,6 +15,9 @@ class NodeItem : public Item
  public:
   using unlocked_type = threadsafe::Unlocked<NodeItem, ItemLockingPolicy>;
 
+ private:
+  mutable OutputCache output_cache_;            // The output of the last call to write_dot_to.
+
  private:
   item_type_type item_type() const override { return item_type_node; }
   void write_dot_to(std::ostream& os, std::string& indentation) const override;
@@ -0,0 +1,65 @@
+#include "sys.h"
+#include "OutputCache.h"
+#include <ostream>
+#include <streambuf>
+
+namespace cppgraphviz::dot {
+
+namespace {
+
+// A stream buffer that passes everything on to another stream buffer, and appends it to copy.
+class TeeStreambuf : public std::streambuf
+{
+ private:
+  std::streambuf* destination_;
+  std::string& copy_;
+
+ public:
+  TeeStreambuf(std::streambuf* destination, std::string& copy) : destination_(destination), copy_(copy) { }
+
+ protected:
+  int_type overflow(int_type c) override
+  {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    copy_.push_back(traits_type::to_char_type(c));
+    return destination_->sputc(traits_type::to_char_type(c));
+  }
+
+  std::streamsize xsputn(char const* s, std::streamsize n) override
+  {
+    copy_.append(s, n);
+    return destination_->sputn(s, n);
+  }
+};
+
+} // namespace
+
+void OutputCache::write_to(std::ostream& os, uint64_t version, size_t indentation_size,
+    std::function<void(std::ostream& os)> const& write_output)
+{
+  if (valid_ && version_ == version && indentation_size_ == indentation_size)
+  {
+    os.write(output_.data(), output_.size());
+    return;
+  }
+
+  // Reuse the memory of the previous output for the copy.
+  output_.clear();
+  TeeStreambuf tee_streambuf(os.rdbuf(), output_);
+  std::ostream tee_os(&tee_streambuf);
+  // Pass on the sticky iomanip values (see DigraphIomanip) to the items that are written to tee_os.
+  tee_os.copyfmt(os);
+  write_output(tee_os);
+  // Don't cache output that wasn't completely written.
+  valid_ = tee_os.good();
+  if (!valid_)
+  {
+    os.setstate(std::ios_base::badbit);
+    return;
+  }
+  version_ = version;
+  indentation_size_ = indentation_size;
+}
+
+} // namespace cppgraphviz::dot
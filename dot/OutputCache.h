@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace cppgraphviz::dot {
+
+// The text that write_dot_to wrote the last time for an item.
+// This only includes the output of other items (the items of a graph) if the graph is told when those change,
+// see GraphItem::enable_subtree_cache.
+class OutputCache
+{
+ private:
+  bool valid_ = false;
+  uint64_t version_;                    // The version of the item that output_ was written for.
+  size_t indentation_size_;             // The size of the indentation that output_ was written with.
+  std::string output_;
+
+ public:
+  // Write the output of an item with the given version and indentation size to os.
+  //
+  // If that output is not cached, write_output is called to write it: directly to os,
+  // while the copy that is kept for the next call is made at the same time.
+  void write_to(std::ostream& os, uint64_t version, size_t indentation_size,
+      std::function<void(std::ostream& os)> const& write_output);
+};
+
+} // namespace cppgraphviz::dot
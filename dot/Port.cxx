@@ -11,9 +11,9 @@ Port::Port(NodePtr::unlocked_type::crat const& node_item_r) : id_(node_item_r->d
 
 void Port::write_to(std::ostream& os) const
 {
-  os << id_;
+  os << Decimal{id_};
   if (port_.has_value())
-    os << ':' << port_.value();
+    os << ':' << Decimal{port_.value()};
 }
 
 } // namespace cppgraphviz::dot
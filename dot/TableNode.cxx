@@ -1,104 +1,363 @@
 #include "sys.h"
 #include "TableNode.h"
+#include "Graph.h"
+#include <charconv>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <string>
 
 namespace cppgraphviz::dot {
 
 namespace {
 
-std::string html_escape(std::string_view input)
+// Write the string to os, escaping the characters that have a special meaning in HTML.
+struct HtmlEscaped
 {
-  std::map<char, std::string> html_entities{
-    {'&', "&amp;"},
-    {'<', "&lt;"},
-    {'>', "&gt;"},
-    {'"', "&quot;"},
-    {'\'', "&#39;"}
-  };
-
-  std::string escaped_string;
-  for (char c : input)
+  std::string_view input_;
+
+  friend std::ostream& operator<<(std::ostream& os, HtmlEscaped const& html_escaped)
   {
-    auto it = html_entities.find(c);
-    if (it != html_entities.end())
-      escaped_string += it->second;
-    else
-      escaped_string += c;
+    std::string_view input = html_escaped.input_;
+    // Write the characters that don't need escaping in one go.
+    size_t begin = 0;
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+      char const* entity;
+      switch (input[i])
+      {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        case '\'': entity = "&#39;"; break;
+        default: continue;
+      }
+      os.write(input.data() + begin, i - begin);
+      os << entity;
+      begin = i + 1;
+    }
+    os.write(input.data() + begin, input.size() - begin);
+    return os;
   }
-  return escaped_string;
+};
+
+// Write the string to os, escaping the characters that have a special meaning in the label of a record shape, or in a quoted string.
+// Because Graphviz translates HTML entities in these labels too, an ampersand is written as an entity.
+struct RecordEscaped
+{
+  std::string_view input_;
+
+  friend std::ostream& operator<<(std::ostream& os, RecordEscaped const& record_escaped)
+  {
+    std::string_view input = record_escaped.input_;
+    size_t begin = 0;
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+      char c = input[i];
+      if (c == '&')
+      {
+        os.write(input.data() + begin, i - begin);
+        os << "&amp;";
+        begin = i + 1;
+        continue;
+      }
+      if (c != '{' && c != '}' && c != '|' && c != '<' && c != '>' && c != '"' && c != '\\')
+        continue;
+      // Write everything up till here, then the backslash; c is written as part of the next run.
+      os.write(input.data() + begin, i - begin);
+      os.put('\\');
+      begin = i;
+    }
+    os.write(input.data() + begin, input.size() - begin);
+    return os;
+  }
+};
+
+// Return true if a row with the attributes eal can only be written as part of an HTML-like label.
+bool needs_styling(AttributeList const& eal)
+{
+  for (char const* key : { "bgcolor", "color", "fontname", "fontsize", "fontcolor" })
+    if (eal.has_key(key))
+      return true;
+  return false;
 }
 
+// Return the value of the attribute key as a number, or default_value if there is no such attribute
+// or its value is not a (representable) number.
+size_t get_size_attribute(AttributeList const& attribute_list, std::string_view key, size_t default_value)
+{
+  if (!attribute_list.has_key(key))
+    return default_value;
+  std::string_view value = attribute_list.get_value(key);
+  size_t result = default_value;
+  auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (ec != std::errc{} || ptr != value.data() + value.size())
+  {
+    Dout(dc::warning, "Ignoring attribute " << key << "=\"" << value << "\": not a number.");
+    return default_value;
+  }
+  return result;
+}
+
+// Write n as a decimal number with a comma between every group of three digits.
+struct ThousandsSeparated
+{
+  size_t n_;
+
+  friend std::ostream& operator<<(std::ostream& os, ThousandsSeparated const& thousands_separated)
+  {
+    char digits[std::numeric_limits<size_t>::digits10 + 1];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), thousands_separated.n_);
+    size_t const number_of_digits = end - digits;
+    // The size of the first group, which can be less than three.
+    size_t group_size = (number_of_digits - 1) % 3 + 1;
+    for (char const* group = digits; group < end; group += group_size, group_size = 3)
+    {
+      if (group != digits)
+        os.put(',');
+      os.write(group, group_size);
+    }
+    return os;
+  }
+};
+
 } // namespace
 
-void TableNodeItem::write_html_to(std::ostream& os, std::string const& indentation) const
+//static
+TableNodeItem::default_row_limits_t TableNodeItem::s_default_row_limits;
+
+TableNodeItem::RowLimits TableNodeItem::row_limits() const
+{
+  RowLimits limits = *default_row_limits_t::crat{s_default_row_limits};
+  limits.head_rows_ = get_size_attribute(attribute_list(), "head_rows", limits.head_rows_);
+  limits.tail_rows_ = get_size_attribute(attribute_list(), "tail_rows", limits.tail_rows_);
+  if (attribute_list().has_key("compress_runs"))
+    limits.compress_runs_ = attribute_list().get_value("compress_runs") == "true";
+  return limits;
+}
+
+void TableNodeItem::write_row_to(std::ostream& os, std::string const& indentation, size_t port,
+    AttributeList const& eal, size_t run_length) const
 {
   bool table_has_bgcolor = attribute_list().has_key("bgcolor");
-  bool table_has_color = attribute_list().has_key("color");
   bool table_has_fontname = attribute_list().has_key("fontname");
   bool table_has_fontsize = attribute_list().has_key("fontsize");
   bool table_has_fontcolor = attribute_list().has_key("fontcolor");
   bool table_has_font = table_has_fontname || table_has_fontsize || table_has_fontcolor;
 
-  os << indentation << dot_id() << " [shape=none, margin=0, label=";
+  os << indentation << "    <TR><TD PORT=\"" << Decimal{port} << "\"";
+  if (eal.has_key("bgcolor"))
+    os << " BGCOLOR=\"" << eal.get_value("bgcolor") << '"';
+  else if (table_has_bgcolor)
+    os << " BGCOLOR=\"" << attribute_list().get_value("bgcolor") << '"';
+  if (eal.has_key("color"))
+    os << " COLOR=\"" << eal.get_value("color") << '"';
+  os << '>';
+  bool has_fontname = eal.has_key("fontname");
+  bool has_fontsize = eal.has_key("fontsize");
+  bool has_fontcolor = eal.has_key("fontcolor");
+  bool has_font = table_has_font || has_fontname || has_fontsize || has_fontcolor;
+  if (has_font)
+  {
+    os << "<FONT";
+    if (has_fontname)
+      os << " FACE=\"" << eal.get_value("fontname") << "\"";
+    else if (table_has_fontname)
+      os << " FACE=\"" << attribute_list().get_value("fontname") << "\"";
+    if (has_fontsize)
+      os << " POINT-SIZE=\"" << eal.get_value("fontsize") << "\"";
+    else if (table_has_fontsize)
+      os << " POINT-SIZE=\"" << attribute_list().get_value("fontsize") << "\"";
+    if (has_fontcolor)
+      os << " COLOR=\"" << eal.get_value("fontcolor") << "\"";
+    else if (table_has_fontcolor)
+      os << " COLOR=\"" << attribute_list().get_value("fontcolor") << "\"";
+    os << '>';
+  }
+  os << HtmlEscaped{eal.get("label", "<no label>")};
+  // A run of rows with the same label.
+  if (run_length > 1)
+    os << " &#215; " << ThousandsSeparated{run_length};
+  if (has_font)
+    os << "</FONT>";
+  os << "</TD></TR>\n";
+}
+
+void TableNodeItem::for_each_written_row(
+    std::function<void(size_t port, AttributeList const& eal, size_t run_length)> const& write_row,
+    std::function<void(size_t number_of_rows)> const& write_summary) const
+{
   size_t size = container_size_();
-  if (size > 0)
+  elided_rows_ = 0;
+
+  RowLimits const limits = row_limits();
+  size_t const tail_begin = limits.tail_rows_ < size ? size - limits.tail_rows_ : 0;
+  auto is_referenced = [this](size_t port){ return referenced_rows_.contains(port); };
+  auto is_written = [&](size_t port){ return port < limits.head_rows_ || port >= tail_begin || is_referenced(port); };
+
+  size_t port = 0;
+  while (port < size)
+  {
+    if (!is_written(port))
+    {
+      // Replace the range of rows that is not written by a single summary row.
+      size_t end = port + 1;
+      while (end < size && !is_written(end))
+        ++end;
+      write_summary(end - port);
+      elided_rows_ += end - port;
+      port = end;
+      continue;
+    }
+
+    TableElement table_element = container_reference_(port);
+    size_t run_length = 1;
+    if (limits.compress_runs_ && !is_referenced(port))
+    {
+      // Lock the rows one at a time: different rows can share the same node.
+      std::string label = table_element.label();
+      while (port + run_length < size && is_written(port + run_length) && !is_referenced(port + run_length) &&
+          container_reference_(port + run_length).label() == label)
+        ++run_length;
+    }
+    {
+      dot::NodePtr::unlocked_type::crat node_item_r{table_element.node_ptr().item()};
+      write_row(port, node_item_r->attribute_list(), run_length);
+    }
+    elided_rows_ += run_length - 1;
+    port += run_length;
+  }
+}
+
+void TableNodeItem::write_html_to(std::ostream& os, std::string const& indentation) const
+{
+  bool table_has_color = attribute_list().has_key("color");
+
+  os << indentation << Decimal{dot_id()} << " [shape=none, margin=0, label=";
+  if (container_size_() > 0)
   {
     os << "<\n" << indentation << "  <TABLE BORDER=\"0\" CELLBORDER=\"1\" CELLSPACING=\"0\" CELLPADDING=\"4\"";
     if (table_has_color)
       os << " COLOR=\"" << attribute_list().get_value("color") << '"';
     os << ">\n";
     //os << indentation << "    <TR><TD BORDER=\"0\"></TD></TR>\n";
-    for (size_t port = 0; port < size; ++port)
-    {
-      TableElement table_element = container_reference_(port);
-      dot::NodePtr::unlocked_type::crat node_item_r{table_element.node_ptr().item()};
-      AttributeList const& eal = node_item_r->attribute_list();
-      os << indentation << "    <TR><TD PORT=\"" << port << "\"";
-      if (eal.has_key("bgcolor"))
-        os << " BGCOLOR=\"" << eal.get_value("bgcolor") << '"';
-      else if (table_has_bgcolor)
-        os << " BGCOLOR=\"" << attribute_list().get_value("bgcolor") << '"';
-      if (eal.has_key("color"))
-        os << " COLOR=\"" << eal.get_value("color") << '"';
-      os << '>';
-      bool has_fontname = eal.has_key("fontname");
-      bool has_fontsize = eal.has_key("fontsize");
-      bool has_fontcolor = eal.has_key("fontcolor");
-      bool has_font = table_has_font || has_fontname || has_fontsize || has_fontcolor;
-      if (has_font)
-      {
-        os << "<FONT";
-        if (has_fontname)
-          os << " FACE=\"" << eal.get_value("fontname") << "\"";
-        else if (table_has_fontname)
-          os << " FACE=\"" << attribute_list().get_value("fontname") << "\"";
-        if (has_fontsize)
-          os << " POINT-SIZE=\"" << eal.get_value("fontsize") << "\"";
-        else if (table_has_fontsize)
-          os << " POINT-SIZE=\"" << attribute_list().get_value("fontsize") << "\"";
-        if (has_fontcolor)
-          os << " COLOR=\"" << eal.get_value("fontcolor") << "\"";
-        else if (table_has_fontcolor)
-          os << " COLOR=\"" << attribute_list().get_value("fontcolor") << "\"";
-        os << '>';
-      }
-      os << html_escape(eal.get("label", "<no label>"));
-      if (has_font)
-        os << "</FONT>";
-      os << "</TD></TR>\n";
-    }
+
+    for_each_written_row(
+        [&](size_t port, AttributeList const& eal, size_t run_length){
+          write_row_to(os, indentation, port, eal, run_length);
+        },
+        [&](size_t number_of_rows){
+          os << indentation << "    <TR><TD><I>&#8230; " << ThousandsSeparated{number_of_rows} << " more</I></TD></TR>\n";
+        });
+
     os << indentation << "  </TABLE>\n" <<
           indentation << ">";
   }
   else
+  {
+    elided_rows_ = 0;
     os << "\"<empty>\"";
+  }
   os << "]\n";
 }
 
+bool TableNodeItem::has_styled_rows() const
+{
+  bool styled = false;
+  for_each_written_port([&](size_t port){
+    if (styled)
+      return;
+    TableElement table_element = container_reference_(port);
+    dot::NodePtr::unlocked_type::crat node_item_r{table_element.node_ptr().item()};
+    styled = needs_styling(node_item_r->attribute_list());
+  });
+  return styled;
+}
+
+void TableNodeItem::write_record_to(std::ostream& os, std::string const& indentation, bool horizontal) const
+{
+  // The style that write_html_to applies to every cell of the table is applied to the node as a whole.
+  os << indentation << Decimal{dot_id()} << " [shape=record";
+  if (attribute_list().has_key("color"))
+    os << ", color=\"" << attribute_list().get_value("color") << '"';
+  if (attribute_list().has_key("bgcolor"))
+    os << ", style=filled, fillcolor=\"" << attribute_list().get_value("bgcolor") << '"';
+  for (char const* key : { "fontname", "fontsize", "fontcolor" })
+    if (attribute_list().has_key(key))
+      os << ", " << key << "=\"" << attribute_list().get_value(key) << '"';
+
+  // The fields of a record are stacked vertically when the rankdir is LR or RL;
+  // with the other rankdirs the curly braces are needed to flip them.
+  os << ", label=\"";
+  if (!horizontal)
+    os << '{';
+  // The field separator; the first field is written without one.
+  char const* separator = "";
+  // Graphviz also translates HTML entities in the labels of a record; use the same ones as write_html_to.
+  for_each_written_row(
+      [&](size_t port, AttributeList const& eal, size_t run_length){
+        // The field name is the port, so that Port (dot_id():port) works the same as for write_html_to.
+        os << separator << '<' << Decimal{port} << "> " << RecordEscaped{eal.get("label", "<no label>")};
+        // A run of rows with the same label.
+        if (run_length > 1)
+          os << " &#215; " << ThousandsSeparated{run_length};
+        separator = "|";
+      },
+      [&](size_t number_of_rows){
+        os << separator << "&#8230; " << ThousandsSeparated{number_of_rows} << " more";
+        separator = "|";
+      });
+  if (!horizontal)
+    os << '}';
+  os << "\"]\n";
+}
+
+void TableNodeItem::for_each_written_port(std::function<void(size_t port)> const& callback) const
+{
+  RowLimits const limits = row_limits();
+  size_t const size = container_size_();
+  size_t const tail_begin = limits.tail_rows_ < size ? size - limits.tail_rows_ : 0;
+  for (size_t port = 0; port < std::min(limits.head_rows_, size); ++port)
+    callback(port);
+  for (size_t port = std::max(tail_begin, std::min(limits.head_rows_, size)); port < size; ++port)
+    callback(port);
+  for (size_t port : referenced_rows_)
+    if (port < size)
+      callback(port);
+}
+
+uint64_t TableNodeItem::version() const
+{
+  uint64_t version = attribute_list().version();
+  RowLimits const limits = row_limits();
+  version = version_combine(version, limits.head_rows_);
+  version = version_combine(version, limits.tail_rows_);
+  version = version_combine(version, limits.compress_runs_);
+  // Rows are only added to referenced_rows_.
+  version = version_combine(version, referenced_rows_.size());
+  version = version_combine(version, container_size_());
+  // Only the rows that can be written matter; of the others only their number is written.
+  for_each_written_port([&](size_t port){
+    TableElement table_element = container_reference_(port);
+    dot::NodePtr::unlocked_type::crat node_item_r{table_element.node_ptr().item()};
+    version = version_combine(version, node_item_r->dot_id());
+    version = version_combine(version, node_item_r->version());
+  });
+  return version;
+}
+
 void TableNodeItem::write_dot_to(std::ostream& os, std::string& indentation) const
 {
-  write_html_to(os, indentation);
+  RankDir const rankdir = RankdirIomanip::get_iword_value(os);
+  bool const horizontal = rankdir == LR || rankdir == RL;
+  // Only write this table again if it, or one of its rows, changed since the last time.
+  output_cache_.write_to(os, version_combine(version(), horizontal), indentation.size(), [&](std::ostream& output){
+    // Graphviz lays out record shapes much faster than HTML-like labels; only use the latter when a row needs it.
+    if (container_size_() == 0 || has_styled_rows())
+      write_html_to(output, indentation);
+    else
+      write_record_to(output, indentation, horizontal);
+  });
 }
 
 } // namespace cppgraphviz::dot
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "Item.h"
+#include "OutputCache.h"
 #include "TableElement.h"
 #include "Port.h"
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <set>
 
 namespace cppgraphviz::dot {
 
@@ -29,11 +34,50 @@ class TableNodeItem : public Item
  public:
   using unlocked_type = threadsafe::Unlocked<TableNodeItem, ItemLockingPolicy>;
 
+  // Limits on the number of rows that write_dot_to writes.
+  //
+  // Only the first head_rows_ and the last tail_rows_ rows are written, plus every row that
+  // a Port was requested for (see at()). Each range of rows in between is replaced by a single
+  // summary row. If compress_runs_ is set, consecutive rows with the same label are written
+  // as a single row too.
+  //
+  // The global default (see set_default_row_limits) can be overridden per table with the
+  // attributes "head_rows", "tail_rows" and "compress_runs" ("true" or "false").
+  struct RowLimits
+  {
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+    size_t head_rows_ = unlimited;
+    size_t tail_rows_ = 0;
+    bool compress_runs_ = false;
+  };
+
  private:
   std::vector<TableElement> copied_elements_;
   std::function<size_t()> container_size_;
   std::function<TableElement(size_t)> container_reference_;
 
+  // Note that ItemLockingPolicy is a primitive mutex: also const member functions are called with exclusive access.
+  mutable std::set<size_t> referenced_rows_;    // The rows that at() was called for.
+  mutable OutputCache output_cache_;            // The output of the last call to write_dot_to.
+  mutable size_t elided_rows_ = 0;              // The number of rows that the last call to write_dot_to did not write.
+
+  using default_row_limits_t = threadsafe::Unlocked<RowLimits, threadsafe::policy::Primitive<std::mutex>>;
+  static default_row_limits_t s_default_row_limits;
+
+ private:
+  RowLimits row_limits() const;
+  void write_row_to(std::ostream& os, std::string const& indentation, size_t port, AttributeList const& eal, size_t run_length) const;
+  // Call write_row for every (run of) row(s) that is written and write_summary for every range of rows in between.
+  void for_each_written_row(std::function<void(size_t port, AttributeList const& eal, size_t run_length)> const& write_row,
+      std::function<void(size_t number_of_rows)> const& write_summary) const;
+  // Call callback for every row that is not replaced by a summary row; a row can be passed more than once.
+  void for_each_written_port(std::function<void(size_t port)> const& callback) const;
+  // Returns true if one of the rows that are written needs styling, which requires write_html_to.
+  bool has_styled_rows() const;
+  // Write this table as a record shape; horizontal must be true when the rankdir of the graph is LR or RL.
+  void write_record_to(std::ostream& os, std::string const& indentation, bool horizontal) const;
+
  public:
   // The link_container member functions store a reference to `container`,
   // which may therefore not be moved, or destroyed after this call.
@@ -56,6 +100,7 @@ class TableNodeItem : public Item
   void copy_elements(std::function<NodePtr (size_t)> at, size_t size)
   {
     link_container(copied_elements_);
+    copied_elements_.reserve(size);
     for (size_t i = 0; i < size; ++i)
       copied_elements_.push_back(at(i));
   }
@@ -73,17 +118,38 @@ class TableNodeItem : public Item
 
   void resize_copied_elements(size_t new_size, dot::NodePtr const& node_ptr)
   {
+    // Grow geometrically, also when called to add one element at a time.
+    if (new_size > copied_elements_.capacity())
+      copied_elements_.reserve(std::max(new_size, 2 * copied_elements_.capacity()));
     dot::NodePtr non_const_node_ptr(node_ptr);
     copied_elements_.resize(new_size, dot::TableElement{non_const_node_ptr});
   }
 
+  // Let the rows be provided by the callbacks instead of storing them in this table node.
+  // The callbacks are only called while this table node is locked.
+  void link_rows(std::function<size_t()> size, std::function<TableElement(size_t)> row)
+  {
+    container_size_ = std::move(size);
+    container_reference_ = std::move(row);
+  }
+
   void write_html_to(std::ostream& os, std::string const& indentation) const;
 
   Port at(size_t index) const
   {
+    // Make sure that this row is written, even when it falls outside the row limits.
+    referenced_rows_.insert(index);
     return {dot_id(), index};
   }
 
+  // The number of rows that were summarized or run-length compressed by the last call to write_dot_to.
+  size_t elided_rows() const { return elided_rows_; }
+
+  static void set_default_row_limits(RowLimits const& row_limits)
+  {
+    *default_row_limits_t::wat{s_default_row_limits} = row_limits;
+  }
+
   void for_all_elements(std::function<void()> callback)
   {
     for (size_t i = 0; i < container_size_(); ++i)
@@ -92,6 +158,7 @@ class TableNodeItem : public Item
 
   item_type_type item_type() const override { return item_type_table_node; }
   void write_dot_to(std::ostream& os, std::string& indentation) const override;
+  uint64_t version() const override;
 };
 
 template<typename T>
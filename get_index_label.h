@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cxxabi.h>
+#include <cstdlib>
 #include <string>
 #include <string_view>
+#include <typeinfo>
 
 namespace cppgraphviz {
 
@@ -21,4 +23,21 @@ std::string get_index_label()
   return result;
 }
 
+// The label of an index type, see index_type_label.
+struct IndexTypeLabel
+{
+  std::string const label_;
+};
+
+// Return the interned label of _Index.
+//
+// The label is only computed (by get_index_label) the first time this is called for a given _Index.
+// Containers refer to it by pointer; the address of the returned object is unique for _Index.
+template<typename _Index>
+IndexTypeLabel const* index_type_label()
+{
+  static IndexTypeLabel const s_index_type_label{get_index_label<_Index>()};
+  return &s_index_type_label;
+}
+
 } // namespace cppgraphviz